@@ -0,0 +1,454 @@
+#pragma once
+
+#include "Transform.hpp"
+#include "TransformStore.hpp"
+#include "Control.hpp"
+#include "Event.hpp"
+#include "Utility.hpp"
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace cf {
+
+/// Active tweens of a cf::Form, which animate positions, sizes and background colors towards target values.
+/// Tweens are kept in contiguous arrays per easing curve. Every frame, the form evaluates all of them in one pass and writes the results in one batch.
+/// Moves write into the form's cf::TransformStore directly, if the target is attached to it. Only resized or recolored objects are redrawn.
+/// Tweens can be started and stopped anytime, also from events fired by the animated objects during a pass. Such changes are applied after the pass.
+/// Not safe for parallel updates.
+class Animator {
+
+public:
+    
+    /// Easing curve of a tween.
+    enum class Easing : uint8_t {
+        Linear,
+        QuadIn,
+        QuadOut,
+        QuadInOut,
+        CubicIn,
+        CubicOut,
+        CubicInOut
+    };
+    
+    /// Repetition of a tween.
+    enum class Repeat : uint8_t {
+        /// Runs once, then fires Finished and ends.
+        Once,
+        /// Starts over from the beginning, until stopped.
+        Loop,
+        /// Runs back and forth, until stopped.
+        PingPong
+    };
+    
+private:
+    
+    enum Channel : uint8_t {
+        Position,
+        Size,
+        Background
+    };
+    
+    /// Ammount of easing curves, one lane each.
+    static constexpr size_t LaneCount = size_t(Easing::CubicInOut) + 1U;
+    
+    /// Lane index of tweens started during a pass, which join their lane after it.
+    static constexpr uint8_t PendingLane = uint8_t(LaneCount);
+    
+    /// Rarely accessed data of a tween, next to its lane arrays.
+    struct Info {
+        uint64_t id;
+        Transform* target;
+        Control* control;
+        Channel channel;
+        Repeat repeat;
+        /// Set if the tween was removed during a pass. It is skipped, and dropped from its lane after the pass.
+        bool removed;
+    };
+    
+    /// Tween started during a pass, until it joins its lane.
+    struct Tween {
+        Info info;
+        Easing easing;
+        float duration;
+        float from[4];
+        float to[4];
+    };
+    
+    /// Tweens of one easing curve, with the hot data as structure of arrays.
+    struct Lane {
+        std::vector<Info> info;
+        std::vector<float> elapsed;
+        std::vector<float> duration;
+        /// Weight of each repetition per tween, 1 for its own and 0 for the others.
+        std::vector<float> weight[3];
+        std::vector<float> progress;
+        std::vector<float> from[4];
+        std::vector<float> to[4];
+        std::vector<float> value[4];
+    };
+    
+    struct Location {
+        uint8_t lane;
+        uint32_t index;
+    };
+    
+    struct Key {
+        Transform* target;
+        Channel channel;
+        
+        bool operator==(const Key& key) const {
+            return target == key.target && channel == key.channel;
+        }
+    };
+    
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<Transform*>()(key.target) ^ (size_t(key.channel) << 1);
+        }
+    };
+    
+    Lane m_lanes[LaneCount];
+    std::unordered_map<uint64_t, Location> m_locations;
+    std::unordered_map<Key, uint64_t, KeyHash> m_keys;
+    std::unordered_map<Transform*, uint32_t> m_targets;
+    std::vector<uint64_t> m_finished;
+    std::vector<Tween> m_pending;
+    uint64_t m_nextid;
+    size_t m_count;
+    size_t m_removed;
+    bool m_running;
+    
+public:
+    
+    /// Fired when a tween which runs once reached its target value. Not fired for stopped or replaced tweens.
+    /// @param sender Animator which fired the event.
+    /// @param id ID of the finished tween.
+    Event<Animator*, const uint64_t&> Finished;
+    
+private:
+    
+    /// Internal call to apply an easing curve to all progress values of a lane.
+    template<typename F>
+    static void __Curve(float* progress, size_t count, F curve) {
+        CF_SIMD
+        for (size_t i = 0; i < count; ++i) progress[i] = curve(progress[i]);
+    }
+    
+    /// Internal call to evaluate all tweens of a lane into their value arrays.
+    static void __Evaluate(Lane& lane, Easing easing, float delta) {
+        size_t count = lane.info.size();
+        float* elapsed = lane.elapsed.data();
+        const float* duration = lane.duration.data();
+        const float* once = lane.weight[size_t(Repeat::Once)].data();
+        const float* loop = lane.weight[size_t(Repeat::Loop)].data();
+        const float* pingpong = lane.weight[size_t(Repeat::PingPong)].data();
+        float* progress = lane.progress.data();
+        CF_SIMD
+        for (size_t i = 0; i < count; ++i) elapsed[i] += delta;
+        // all repetitions are computed and weighted per tween, so the loop has no branches.
+        // elapsed times are never negative, so truncation floors them without SSE4 rounding.
+        CF_SIMD
+        for (size_t i = 0; i < count; ++i) {
+            float u = elapsed[i] / duration[i];
+            float half = u * 0.5f;
+            float ponce = u < 1.0f ? u : 1.0f;
+            float ploop = u - float(int32_t(u));
+            float ppingpong = 1.0f - std::fabs(2.0f * (half - float(int32_t(half))) - 1.0f);
+            progress[i] = ponce * once[i] + ploop * loop[i] + ppingpong * pingpong[i];
+        }
+        switch (easing) {
+            case Easing::Linear:
+                break;
+            case Easing::QuadIn:
+                __Curve(progress, count, [](float t) { return t * t; });
+                break;
+            case Easing::QuadOut:
+                __Curve(progress, count, [](float t) { return t * (2.0f - t); });
+                break;
+            case Easing::QuadInOut:
+                __Curve(progress, count, [](float t) {
+                    // both halves are weighted instead of selected, as a select would become a branch at -O2
+                    float second = float(t >= 0.5f);
+                    float in = 2.0f * t * t;
+                    float out = 1.0f - 2.0f * (1.0f - t) * (1.0f - t);
+                    return in * (1.0f - second) + out * second;
+                });
+                break;
+            case Easing::CubicIn:
+                __Curve(progress, count, [](float t) { return t * t * t; });
+                break;
+            case Easing::CubicOut:
+                __Curve(progress, count, [](float t) { return 1.0f - (1.0f - t) * (1.0f - t) * (1.0f - t); });
+                break;
+            case Easing::CubicInOut:
+                __Curve(progress, count, [](float t) {
+                    float second = float(t >= 0.5f);
+                    float in = 4.0f * t * t * t;
+                    float out = 1.0f - 4.0f * (1.0f - t) * (1.0f - t) * (1.0f - t);
+                    return in * (1.0f - second) + out * second;
+                });
+                break;
+        }
+        for (size_t k = 0; k < 4U; ++k) {
+            const float* from = lane.from[k].data();
+            const float* to = lane.to[k].data();
+            float* value = lane.value[k].data();
+            CF_SIMD
+            for (size_t i = 0; i < count; ++i) value[i] = from[i] + (to[i] - from[i]) * progress[i];
+        }
+    }
+    
+    /// Internal call to write a value into the target of a tween. The info is taken by value, as event handlers of the target may change the lanes.
+    static void __Write(Info info, const float (&value)[4]) {
+        switch (info.channel) {
+            case Position: {
+                if (TransformStore* store = info.target->Store()) {
+                    store->X()[info.target->Slot()] = value[0];
+                    store->Y()[info.target->Slot()] = value[1];
+                    store->MarkChanged(info.target->Slot());
+                }
+                else {
+                    info.target->SetPosition(sf::Vector2f(value[0], value[1]));
+                }
+                break;
+            }
+            case Size:
+                info.target->SetSize(sf::Vector2u(uint(std::lround(value[0])), uint(std::lround(value[1]))));
+                break;
+            case Background: {
+                sf::Color color(uint8_t(std::lround(value[0])), uint8_t(std::lround(value[1])), uint8_t(std::lround(value[2])), uint8_t(std::lround(value[3])));
+                if (color == info.control->Background()) break;
+                info.control->SetBackground(color);
+                info.control->SetDirty();
+                break;
+            }
+        }
+    }
+    
+    /// Internal call to start a tween, replacing a running tween of the same target and channel.
+    uint64_t __Add(Transform* target, Control* control, Channel channel, const float (&from)[4], const float (&to)[4], const sf::Time& duration, Easing easing, Repeat repeat) {
+        auto key = m_keys.find(Key{target, channel});
+        if (key != m_keys.end()) __Remove(key->second);
+        uint64_t id = ++m_nextid;
+        Tween tween{Info{id, target, control, channel, repeat, false}, easing, std::max(duration.asSeconds(), 1e-6f), {}, {}};
+        std::copy(std::begin(from), std::end(from), tween.from);
+        std::copy(std::begin(to), std::end(to), tween.to);
+        m_keys[Key{target, channel}] = id;
+        if (m_targets[target]++ == 0U) target->__Destroyed.Bind(&Animator::__OnTargetDestroyed, this);
+        m_count++;
+        if (m_running) {
+            // the lanes are iterated, so the tween joins them after the pass
+            m_locations[id] = Location{PendingLane, uint32_t(m_pending.size())};
+            m_pending.push_back(tween);
+        }
+        else {
+            __Insert(tween);
+        }
+        return id;
+    }
+    
+    /// Internal call to append a tween to its lane.
+    void __Insert(const Tween& tween) {
+        uint8_t index = uint8_t(tween.easing);
+        Lane& lane = m_lanes[index];
+        m_locations[tween.info.id] = Location{index, uint32_t(lane.info.size())};
+        lane.info.push_back(tween.info);
+        lane.elapsed.push_back(0.0f);
+        lane.duration.push_back(tween.duration);
+        for (size_t k = 0; k < 3U; ++k) lane.weight[k].push_back(k == size_t(tween.info.repeat) ? 1.0f : 0.0f);
+        lane.progress.push_back(0.0f);
+        for (size_t k = 0; k < 4U; ++k) {
+            lane.from[k].push_back(tween.from[k]);
+            lane.to[k].push_back(tween.to[k]);
+            lane.value[k].push_back(tween.from[k]);
+        }
+    }
+    
+    /// Internal call to remove a tween. During a pass, it is only flagged and dropped from its lane afterwards.
+    bool __Remove(uint64_t id) {
+        auto it = m_locations.find(id);
+        if (it == m_locations.end()) return false;
+        Location location = it->second;
+        Info& info = location.lane == PendingLane ? m_pending[location.index].info : m_lanes[location.lane].info[location.index];
+        Transform* target = info.target;
+        m_locations.erase(it);
+        m_keys.erase(Key{target, info.channel});
+        m_count--;
+        if (m_running) {
+            info.removed = true;
+            m_removed++;
+        }
+        else {
+            __Erase(m_lanes[location.lane], location.index);
+        }
+        auto targets = m_targets.find(target);
+        if (--targets->second == 0U) {
+            target->__Destroyed.Unbind(&Animator::__OnTargetDestroyed, this);
+            m_targets.erase(targets);
+        }
+        return true;
+    }
+    
+    /// Internal call to drop a tween from its lane, by moving the last tween of the lane into its place.
+    void __Erase(Lane& lane, size_t i) {
+        size_t last = lane.info.size() - 1U;
+        if (i != last) {
+            lane.info[i] = lane.info[last];
+            lane.elapsed[i] = lane.elapsed[last];
+            lane.duration[i] = lane.duration[last];
+            for (size_t k = 0; k < 3U; ++k) lane.weight[k][i] = lane.weight[k][last];
+            lane.progress[i] = lane.progress[last];
+            for (size_t k = 0; k < 4U; ++k) {
+                lane.from[k][i] = lane.from[k][last];
+                lane.to[k][i] = lane.to[k][last];
+                lane.value[k][i] = lane.value[k][last];
+            }
+            if (!lane.info[i].removed) m_locations[lane.info[i].id].index = uint32_t(i);
+        }
+        lane.info.pop_back();
+        lane.elapsed.pop_back();
+        lane.duration.pop_back();
+        for (size_t k = 0; k < 3U; ++k) lane.weight[k].pop_back();
+        lane.progress.pop_back();
+        for (size_t k = 0; k < 4U; ++k) {
+            lane.from[k].pop_back();
+            lane.to[k].pop_back();
+            lane.value[k].pop_back();
+        }
+    }
+    
+    /// Internal handler call to drop the tweens of a destroyed transform.
+    void __OnTargetDestroyed(Transform* target) {
+        for (Channel channel : {Position, Size, Background}) {
+            auto key = m_keys.find(Key{target, channel});
+            if (key != m_keys.end()) __Remove(key->second);
+        }
+    }
+    
+public:
+    
+    /// Move a transform to a position.
+    /// @return ID of the tween, to stop it. A running move of the same transform is replaced.
+    uint64_t Move(Transform* target, const sf::Vector2f& to, const sf::Time& duration, Easing easing = Easing::Linear, Repeat repeat = Repeat::Once) {
+        sf::Vector2f position = target->Position();
+        return __Add(target, nullptr, Position, {position.x, position.y, 0.0f, 0.0f}, {to.x, to.y, 0.0f, 0.0f}, duration, easing, repeat);
+    }
+    
+    /// Resize a transform. Drawables recreate their canvas on every change, so prefer moves and colors for large ammounts of objects.
+    /// @return ID of the tween, to stop it. A running resize of the same transform is replaced.
+    uint64_t Resize(Transform* target, const sf::Vector2u& to, const sf::Time& duration, Easing easing = Easing::Linear, Repeat repeat = Repeat::Once) {
+        sf::Vector2u size = target->Size();
+        return __Add(target, nullptr, Size, {float(size.x), float(size.y), 0.0f, 0.0f}, {float(to.x), float(to.y), 0.0f, 0.0f}, duration, easing, repeat);
+    }
+    
+    /// Change the background color of a control, e.g. to pulse status indicators.
+    /// @return ID of the tween, to stop it. A running recolor of the same control is replaced.
+    uint64_t Recolor(Control* target, const sf::Color& to, const sf::Time& duration, Easing easing = Easing::Linear, Repeat repeat = Repeat::Once) {
+        const sf::Color& color = target->Background();
+        return __Add(target->Transform(), target, Background, {float(color.r), float(color.g), float(color.b), float(color.a)}, {float(to.r), float(to.g), float(to.b), float(to.a)}, duration, easing, repeat);
+    }
+    
+    /// Stop a tween where it is. Returns false if the tween is unknown or already finished.
+    /// @param finish If true, the target jumps to the end value first.
+    bool Stop(uint64_t id, bool finish = false) {
+        auto it = m_locations.find(id);
+        if (it == m_locations.end()) return false;
+        if (finish) {
+            Location location = it->second;
+            float value[4];
+            if (location.lane == PendingLane) {
+                const Tween& tween = m_pending[location.index];
+                std::copy(std::begin(tween.to), std::end(tween.to), value);
+                __Write(tween.info, value);
+            }
+            else {
+                const Lane& lane = m_lanes[location.lane];
+                for (size_t k = 0; k < 4U; ++k) value[k] = lane.to[k][location.index];
+                __Write(lane.info[location.index], value);
+            }
+        }
+        // the handlers of the write may have stopped the tween already
+        return __Remove(id);
+    }
+    
+    /// Stop all tweens of a transform where they are.
+    void StopAll(Transform* target) {
+        __OnTargetDestroyed(target);
+    }
+    
+    /// True if the tween is running.
+    bool IsRunning(uint64_t id) const {
+        return m_locations.count(id) != 0U;
+    }
+    
+    /// Ammount of running tweens.
+    size_t ActiveCount() const {
+        return m_count;
+    }
+    
+    /// Internal call to advance all tweens by the elapsed time, and write their values into the targets. Called once per frame by the form.
+    void __Run(const sf::Time& delta) {
+        if (m_count == 0U || m_running) return;
+        float seconds = delta.asSeconds();
+        // events of the targets may start and stop tweens, which are only flagged or queued until the pass ends
+        m_running = true;
+        for (size_t l = 0; l < LaneCount; ++l) {
+            Lane& lane = m_lanes[l];
+            if (lane.info.empty()) continue;
+            __Evaluate(lane, Easing(l), seconds);
+            for (size_t i = 0; i < lane.info.size(); ++i) {
+                if (lane.info[i].removed) continue;
+                float value[4] = {lane.value[0][i], lane.value[1][i], lane.value[2][i], lane.value[3][i]};
+                __Write(lane.info[i], value);
+                if (lane.info[i].removed) continue;
+                if (lane.info[i].repeat != Repeat::Once) {
+                    // whole back and forth cycles are dropped, so the elapsed time stays small
+                    lane.elapsed[i] = std::fmod(lane.elapsed[i], 2.0f * lane.duration[i]);
+                }
+                else if (lane.elapsed[i] >= lane.duration[i]) {
+                    m_finished.push_back(lane.info[i].id);
+                }
+            }
+        }
+        m_running = false;
+        if (m_removed != 0U) {
+            // backwards, so every tween moved into a gap was already kept
+            for (Lane& lane : m_lanes) {
+                for (size_t i = lane.info.size(); i > 0U; --i) {
+                    if (lane.info[i - 1U].removed) __Erase(lane, i - 1U);
+                }
+            }
+            m_removed = 0U;
+        }
+        for (const Tween& tween : m_pending) {
+            if (!tween.info.removed) __Insert(tween);
+        }
+        m_pending.clear();
+        // removed and reported after the pass, so handlers can start new tweens
+        m_finished.erase(std::remove_if(m_finished.begin(), m_finished.end(), [this](uint64_t id) { return !__Remove(id); }), m_finished.end());
+        for (uint64_t id : m_finished) Finished(this, id);
+        m_finished.clear();
+    }
+    
+    Animator(const Animator&) = delete;
+    
+    Animator() {
+        m_nextid = 0U;
+        m_count = 0U;
+        m_removed = 0U;
+        m_running = false;
+    }
+    
+    ~Animator() {
+        for (auto& target : m_targets) target.first->__Destroyed.Unbind(&Animator::__OnTargetDestroyed, this);
+    }
+    
+};
+
+}
\ No newline at end of file
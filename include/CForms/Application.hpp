@@ -0,0 +1,222 @@
+#pragma once
+
+#include "ObjectOwner.hpp"
+#include "Form.hpp"
+#include "ResourceCache.hpp"
+
+#include <SFML/System.hpp>
+#include <X11/Xlib.h>
+#include <string>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+namespace cf {
+
+/// Owner of several forms, which runs all of them in one process.
+/// By default, the forms are pumped frame by frame on the thread of Run(), each one paced to its own frame limit.
+/// All forms share one X display connection and one cf::ResourceCache, and SFML shares OpenGL resources between all of their windows.
+class Application : public ObjectOwner {
+
+private:
+    
+    struct Entry {
+        Form* form;
+        sf::Time due;
+        bool started;
+        bool running;
+    };
+    
+    std::vector<Entry> m_forms;
+    std::shared_ptr<ResourceCache> m_resources;
+    Display* m_display;
+    sf::Clock m_clock;
+    bool m_running;
+    
+protected:
+    
+    /// Threaded mode. If true, every form runs its own loop on a dedicated thread, instead of being pumped on the thread of Run().
+    /// Forms can not be created or deleted while the application runs in this mode. Must be set before Run(), e.g. in the constructor.
+    bool m_threaded;
+    
+private:
+    
+    /// Internal call to find the entry of a form.
+    std::vector<Entry>::iterator __Find(Form* form) {
+        return std::find_if(m_forms.begin(), m_forms.end(), [form](const Entry& entry) { return entry.form == form; });
+    }
+    
+    /// Internal call to open the X display connection shared by the forms.
+    void __OpenDisplay() {
+        m_display = XOpenDisplay(nullptr);
+        for (auto& entry : m_forms) entry.form->m_display = m_display;
+    }
+    
+    /// Internal call to close the X display connection shared by the forms.
+    void __CloseDisplay() {
+        for (auto& entry : m_forms) entry.form->m_display = nullptr;
+        if (m_display) XCloseDisplay(m_display);
+        m_display = nullptr;
+    }
+    
+    /// Internal call to run each form on a dedicated thread, until all of them are closed.
+    void __RunThreaded() {
+        std::vector<std::thread> threads;
+        for (auto& entry : m_forms) {
+            entry.form->m_pumped = false;
+            threads.emplace_back(&Form::Open, entry.form);
+        }
+        for (auto& thread : threads) thread.join();
+    }
+    
+    /// Internal call to pump the frames of all forms on the calling thread, until all of them are closed.
+    void __RunPumped() {
+        for (auto& entry : m_forms) entry.started = false;
+        while (true) {
+            sf::Time now = m_clock.getElapsedTime();
+            sf::Time next = sf::Time::Zero;
+            bool running = false;
+            // indexed, as forms may create further forms during their frames
+            for (size_t i = 0; i < m_forms.size(); ++i) {
+                Form* form = m_forms[i].form;
+                if (!m_forms[i].started) {
+                    m_forms[i].started = true;
+                    form->m_pumped = true;
+                    m_forms[i].running = form->__Start();
+                    m_forms[i].due = now;
+                }
+                if (!m_forms[i].running) continue;
+                if (m_forms[i].due <= now) {
+                    if (!form->__CanSkipFrame()) form->__Frame();
+                    if (!form->__IsOpen()) {
+                        m_forms[i].running = false;
+                        form->__Finish();
+                        continue;
+                    }
+                    m_forms[i].due = std::max(m_forms[i].due + __Period(form), now);
+                }
+                next = running ? std::min(next, m_forms[i].due) : m_forms[i].due;
+                running = true;
+            }
+            __FlushPending();
+            if (!running) break;
+            sf::Time wait = next - m_clock.getElapsedTime();
+            if (wait > sf::Time::Zero) sf::sleep(wait);
+        }
+        for (auto& entry : m_forms) entry.form->m_pumped = false;
+    }
+    
+    /// Internal call to get the time between two frames of a pumped form. Headless forms ignore their frame limit, like on their own.
+    static sf::Time __Period(Form* form) {
+        if (form->m_headless) return sf::Time::Zero;
+        // idle forms without a frame limit still have to poll their window events
+        uint32_t limit = form->m_framelimit;
+        if (limit == 0U && form->m_idle) limit = 60U;
+        return limit != 0U ? sf::seconds(1.0f / float(limit)) : sf::Time::Zero;
+    }
+    
+    /// Internal handler call to manage created forms.
+    void __OnObjectCreated(ObjectOwner* sender, Object*& object) {
+        Form* form = dynamic_cast<Form*>(object);
+        if (!form) return;
+        Register<Form>(form);
+        form->m_resources = m_resources;
+        form->m_display = m_display;
+        m_forms.push_back(Entry{form, sf::Time::Zero, false, false});
+    }
+    
+    /// Internal handler call to manage deleted forms. Running forms are closed first.
+    void __OnObjectDeleted(ObjectOwner* sender, Object*& object) {
+        Form* form = dynamic_cast<Form*>(object);
+        if (!form) return;
+        auto it = __Find(form);
+        if (it == m_forms.end()) return;
+        if (it->running) {
+            form->__Stop();
+            form->__Finish();
+        }
+        form->m_display = nullptr;
+        m_forms.erase(it);
+    }
+    
+public:
+    
+    /// Create a new form of type <TForm>. Forms created while the application runs are opened with the next frame.
+    /// @param name Name for the form. Should be unique inside the application!
+    template<typename TForm>
+    TForm* CreateForm(const std::string& name) {
+        static_assert(std::is_base_of<Form, TForm>::value, "TForm must inherit from cf::Form");
+        if (m_running && m_threaded) {
+            std::cerr << "[X] '" + m_name + "': Failed to create form '" + name + "'. Not possible while running in threaded mode.\n";
+            return nullptr;
+        }
+        return Create<TForm>(name);
+    }
+    
+    /// Delete a form. A running form is closed at the end of the current frame.
+    bool DeleteForm(Form* form) {
+        if (m_running && m_threaded) {
+            std::cerr << "[X] '" + m_name + "': Failed to delete form '" + form->Name() + "'. Not possible while running in threaded mode.\n";
+            return false;
+        }
+        if (m_running) return DeleteLater(form);
+        return Delete(form);
+    }
+    
+    /// Open all forms, and run them until every one of them is closed.
+    virtual void Run() {
+        if (m_running) return;
+        m_running = true;
+        __OpenDisplay();
+        m_clock.restart();
+        if (m_threaded) __RunThreaded();
+        else __RunPumped();
+        __CloseDisplay();
+        m_running = false;
+    }
+    
+    /// Close all forms at the end of their current frame. Idle forms in threaded mode close with their next window event or timer.
+    virtual void Quit() {
+        for (auto& entry : m_forms) entry.form->Close();
+    }
+    
+    /// True while Run() is running.
+    bool IsRunning() const {
+        return m_running;
+    }
+    
+    /// Ammount of forms which are currently open.
+    size_t OpenCount() const {
+        return size_t(std::count_if(m_forms.begin(), m_forms.end(), [](const Entry& entry) { return entry.form->__IsOpen(); }));
+    }
+    
+    /// Cache of textures and fonts shared by all forms.
+    ResourceCache* Resources() {
+        return m_resources.get();
+    }
+    
+    Application(ObjectOwner* owner, const std::string& name) : Object(owner, name) {
+        // several forms use Xlib at once, which has to be set up before any form exists
+        Form::__InitThreads();
+        m_resources = std::make_shared<ResourceCache>();
+        m_display = nullptr;
+        m_running = false;
+        m_threaded = false;
+        ObjectCreated.Bind(&cf::Application::__OnObjectCreated, this);
+        ObjectDeleted.Bind(&cf::Application::__OnObjectDeleted, this);
+    }
+    
+    Application(const std::string& name) : Application(nullptr, name) {}
+    
+    Application() : Application(nullptr, "Application") {}
+    
+    virtual ~Application() {
+        ObjectCreated.Unbind(&cf::Application::__OnObjectCreated, this);
+        ObjectDeleted.Unbind(&cf::Application::__OnObjectDeleted, this);
+    }
+    
+};
+
+}
\ No newline at end of file
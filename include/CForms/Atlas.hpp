@@ -0,0 +1,290 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+namespace cf {
+
+/// Sub-rectangle of a shared atlas page, assigned to a single drawable object.
+struct AtlasRegion {
+    
+    /// Render texture page which contains the region.
+    sf::RenderTexture* page;
+    
+    /// Pixel rectangle of the region inside its page.
+    sf::IntRect rect;
+    
+    /// Nesting layer the region was allocated for.
+    uint32_t layer;
+    
+    /// True if the region was moved by a repack. Its contents are lost and have to be redrawn.
+    bool relocated;
+    
+};
+
+/// Storage type for shared, packed render textures of a cf::Form.
+/// Drawable objects of the same nesting layer share pages, so an object is never composited into a page it is sampled from.
+/// Allocating and freeing regions is safe from parallel updates.
+class Atlas {
+
+private:
+    
+    struct Shelf {
+        uint32_t y;
+        uint32_t height;
+        uint32_t x;
+    };
+    
+    struct Page {
+        std::unique_ptr<sf::RenderTexture> texture;
+        std::vector<Shelf> shelves;
+        uint32_t layer;
+        uint32_t top;
+        uint64_t freed;
+        size_t regions;
+    };
+    
+    /// Gap between two regions, in pixels.
+    static constexpr uint32_t Padding = 1U;
+    
+    std::vector<std::unique_ptr<Page>> m_pages;
+    std::unordered_map<AtlasRegion*, std::unique_ptr<AtlasRegion>> m_regions;
+    sf::Vector2u m_pagesize;
+    std::recursive_mutex m_mutex;
+    
+private:
+    
+    /// Internal call to find the page of a render texture.
+    Page* __FindPage(const sf::RenderTexture* texture) {
+        for (auto& page : m_pages) {
+            if (page->texture.get() == texture) return page.get();
+        }
+        return nullptr;
+    }
+    
+    /// Internal call to create a new page for the given layer.
+    Page* __CreatePage(uint32_t layer) {
+        auto page = std::make_unique<Page>();
+        page->texture = std::make_unique<sf::RenderTexture>();
+        if (!page->texture->create(m_pagesize.x, m_pagesize.y)) {
+            std::cerr << "[X] Atlas: Failed to create page of layer " + std::to_string(layer) + ".\n";
+            return nullptr;
+        }
+        page->layer = layer;
+        page->top = 0U;
+        page->freed = 0U;
+        page->regions = 0U;
+        return m_pages.emplace_back(std::move(page)).get();
+    }
+    
+    /// Internal call to pack a rectangle of the given size into a page, using shelves of similar height.
+    bool __Insert(Page& page, const sf::Vector2u& size, sf::IntRect& rect) {
+        uint32_t width = size.x + Padding;
+        uint32_t height = size.y + Padding;
+        Shelf* best = nullptr;
+        for (auto& shelf : page.shelves) {
+            if (shelf.height < height || m_pagesize.x - shelf.x < width) continue;
+            if (!best || shelf.height < best->height) best = &shelf;
+        }
+        // open a new shelf instead of wasting more than half of an existing one
+        bool wasteful = best && best->height > height * 2U;
+        if ((!best || wasteful) && page.top + height <= m_pagesize.y) {
+            best = &page.shelves.emplace_back(Shelf{page.top, height, 0U});
+            page.top += height;
+        }
+        if (!best) return false;
+        rect = sf::IntRect(best->x, best->y, size.x, size.y);
+        best->x += width;
+        page.regions++;
+        return true;
+    }
+    
+    /// Internal call to undo a failed repack of a layer.
+    /// @param pages Previous state of the pages of the layer, in page order.
+    /// @param previous Previous state of the regions.
+    /// @param count Ammount of pages before the repack. Pages created since then are dropped.
+    void __Restore(uint32_t layer, std::vector<Page>& pages, const std::vector<AtlasRegion*>& regions, const std::vector<AtlasRegion>& previous, size_t count) {
+        m_pages.resize(count);
+        size_t index = 0U;
+        for (auto& page : m_pages) {
+            if (page->layer != layer) continue;
+            Page& state = pages[index++];
+            page->shelves = std::move(state.shelves);
+            page->top = state.top;
+            page->freed = state.freed;
+            page->regions = state.regions;
+        }
+        for (size_t i = 0U; i < regions.size(); ++i) *regions[i] = previous[i];
+    }
+    
+    /// Internal call to drop empty pages of a layer, keeping one page for later allocations.
+    void __DropEmptyPages(uint32_t layer) {
+        bool keep = true;
+        for (auto it = m_pages.begin(); it != m_pages.end();) {
+            Page& page = **it;
+            if (page.layer != layer || page.regions != 0U) {
+                if (page.layer == layer) keep = false;
+                ++it;
+                continue;
+            }
+            if (keep) {
+                page.shelves.clear();
+                page.top = 0U;
+                page.freed = 0U;
+                keep = false;
+                ++it;
+                continue;
+            }
+            it = m_pages.erase(it);
+        }
+    }
+    
+public:
+    
+    /// Allocate a region of the given size in a page of the given layer.
+    /// Returns nullptr if the size does not fit into a page. The caller should use its own render texture instead.
+    AtlasRegion* Allocate(const sf::Vector2u& size, uint32_t layer) {
+        if (size.x == 0U || size.y == 0U) return nullptr;
+        if (size.x + Padding > m_pagesize.x || size.y + Padding > m_pagesize.y) return nullptr;
+        std::lock_guard<std::recursive_mutex> lock(m_mutex);
+        
+        auto region = std::make_unique<AtlasRegion>();
+        region->layer = layer;
+        region->relocated = false;
+        
+        uint64_t freed = 0U;
+        for (auto& page : m_pages) {
+            if (page->layer != layer) continue;
+            freed += page->freed;
+            if (__Insert(*page, size, region->rect)) {
+                region->page = page->texture.get();
+                AtlasRegion* ptr = region.get();
+                m_regions[ptr] = std::move(region);
+                return ptr;
+            }
+        }
+        
+        // enough space was freed to be worth compacting, before growing the atlas
+        if (freed >= uint64_t(size.x + Padding) * uint64_t(size.y + Padding)) {
+            Repack(layer);
+            for (auto& page : m_pages) {
+                if (page->layer != layer) continue;
+                if (__Insert(*page, size, region->rect)) {
+                    region->page = page->texture.get();
+                    AtlasRegion* ptr = region.get();
+                    m_regions[ptr] = std::move(region);
+                    return ptr;
+                }
+            }
+        }
+        
+        Page* page = __CreatePage(layer);
+        if (!page || !__Insert(*page, size, region->rect)) return nullptr;
+        region->page = page->texture.get();
+        AtlasRegion* ptr = region.get();
+        m_regions[ptr] = std::move(region);
+        return ptr;
+    }
+    
+    /// Release a region, previously allocated by Allocate().
+    void Free(AtlasRegion* region) {
+        std::lock_guard<std::recursive_mutex> lock(m_mutex);
+        auto it = m_regions.find(region);
+        if (it == m_regions.end()) return;
+        uint32_t layer = region->layer;
+        if (Page* page = __FindPage(region->page)) {
+            page->freed += uint64_t(region->rect.width + Padding) * uint64_t(region->rect.height + Padding);
+            page->regions--;
+        }
+        m_regions.erase(it);
+        __DropEmptyPages(layer);
+    }
+    
+    /// Pack all regions of a layer again, to reclaim space of freed regions.
+    /// Moved regions are flagged as relocated, so their objects redraw them.
+    /// If a region can not be placed, e.g. because no new page could be created, the layer is left as it was.
+    void Repack(uint32_t layer) {
+        std::lock_guard<std::recursive_mutex> lock(m_mutex);
+        std::vector<AtlasRegion*> regions;
+        for (auto& entry : m_regions) {
+            if (entry.first->layer == layer) regions.push_back(entry.first);
+        }
+        std::sort(regions.begin(), regions.end(), [](AtlasRegion* a, AtlasRegion* b) {
+            if (a->rect.height != b->rect.height) return a->rect.height > b->rect.height;
+            return a->rect.width > b->rect.width;
+        });
+        // previous state of the layer, to roll back if a region does not fit anymore
+        std::vector<Page> pages;
+        std::vector<AtlasRegion> previous;
+        size_t count = m_pages.size();
+        for (AtlasRegion* region : regions) previous.push_back(*region);
+        for (auto& page : m_pages) {
+            if (page->layer != layer) continue;
+            pages.push_back(Page{nullptr, page->shelves, page->layer, page->top, page->freed, page->regions});
+            page->shelves.clear();
+            page->top = 0U;
+            page->freed = 0U;
+            page->regions = 0U;
+        }
+        for (size_t i = 0U; i < regions.size(); ++i) {
+            AtlasRegion* region = regions[i];
+            sf::Vector2u size(region->rect.width, region->rect.height);
+            sf::IntRect rect = region->rect;
+            Page* target = nullptr;
+            for (auto& page : m_pages) {
+                if (page->layer == layer && __Insert(*page, size, rect)) {
+                    target = page.get();
+                    break;
+                }
+            }
+            if (!target) {
+                target = __CreatePage(layer);
+                if (!target || !__Insert(*target, size, rect)) {
+                    std::cerr << "[X] Atlas: Failed to repack region of layer " + std::to_string(layer) + ".\n";
+                    __Restore(layer, pages, regions, previous, count);
+                    return;
+                }
+            }
+            if (target->texture.get() != previous[i].page || rect != region->rect) {
+                region->page = target->texture.get();
+                region->rect = rect;
+                region->relocated = true;
+            }
+        }
+        __DropEmptyPages(layer);
+    }
+    
+    /// Current ammount of pages.
+    size_t PageCount() const {
+        return m_pages.size();
+    }
+    
+    /// Current ammount of allocated regions.
+    size_t RegionCount() const {
+        return m_regions.size();
+    }
+    
+    /// Size of a single page.
+    const sf::Vector2u& PageSize() const {
+        return m_pagesize;
+    }
+    
+    /// @param pagesize Size of a single page. Clamped to the maximum texture size of the graphics driver.
+    Atlas(const sf::Vector2u& pagesize) {
+        uint32_t max = sf::Texture::getMaximumSize();
+        m_pagesize = sf::Vector2u(std::min(pagesize.x, max), std::min(pagesize.y, max));
+    }
+    
+    Atlas() : Atlas({2048U, 2048U}) {}
+    
+    ~Atlas() {}
+    
+};
+
+}
\ No newline at end of file
@@ -97,6 +97,20 @@ public:
         return true;
     }
     
+    // Removes all given items from the collection in a single pass
+    size_t RemoveAll(std::vector<T*> items) {
+        if (items.empty()) {
+            return 0;
+        }
+        std::sort(items.begin(), items.end());
+        auto it = std::remove_if(m_items.begin(), m_items.end(), [&items](T* inner) {
+            return std::binary_search(items.begin(), items.end(), inner);
+        });
+        size_t count = m_items.end() - it;
+        m_items.erase(it, m_items.end());
+        return count;
+    }
+    
     // Add an item to the collection
     bool Add(T* item) {
         for (const auto& inner : m_items) {
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+
+namespace cf {
+
+/// Batching type to composite textured quads of drawable objects with as few draw calls as possible.
+/// Consecutive quads of the same texture are merged into one vertex array, so the drawing order is kept.
+class Compositor {
+
+private:
+    
+    struct Batch {
+        const sf::Texture* texture;
+        sf::VertexArray vertices;
+    };
+    
+    std::vector<Batch> m_batches;
+    size_t m_count;
+    size_t m_quads;
+    size_t m_drawcalls;
+    
+public:
+    
+    /// Add a textured quad to the current frame.
+    /// @param texture Source texture of the quad.
+    /// @param rect Pixel rectangle of the quad inside the texture.
+    /// @param position Target position of the quad's top left corner.
+    void Add(const sf::Texture& texture, const sf::IntRect& rect, const sf::Vector2f& position) {
+        if (m_count == 0U || m_batches[m_count - 1U].texture != &texture) {
+            if (m_count == m_batches.size()) {
+                m_batches.push_back({nullptr, sf::VertexArray(sf::Triangles)});
+            }
+            Batch& batch = m_batches[m_count++];
+            batch.texture = &texture;
+            batch.vertices.clear();
+        }
+        sf::VertexArray& vertices = m_batches[m_count - 1U].vertices;
+        float left = float(rect.left);
+        float top = float(rect.top);
+        float right = left + float(rect.width);
+        float bottom = top + float(rect.height);
+        sf::Vector2f size(float(rect.width), float(rect.height));
+        sf::Vertex tl(position, sf::Vector2f(left, top));
+        sf::Vertex tr(sf::Vector2f(position.x + size.x, position.y), sf::Vector2f(right, top));
+        sf::Vertex bl(sf::Vector2f(position.x, position.y + size.y), sf::Vector2f(left, bottom));
+        sf::Vertex br(position + size, sf::Vector2f(right, bottom));
+        vertices.append(tl);
+        vertices.append(tr);
+        vertices.append(bl);
+        vertices.append(bl);
+        vertices.append(tr);
+        vertices.append(br);
+        m_quads++;
+    }
+    
+    /// Submit all quads of the current frame to the render target, then start a new frame.
+    void Draw(sf::RenderTarget& target) {
+        m_drawcalls = 0U;
+        for (size_t i = 0; i < m_count; ++i) {
+            target.draw(m_batches[i].vertices, sf::RenderStates(m_batches[i].texture));
+            m_drawcalls++;
+        }
+        Clear();
+    }
+    
+    /// Discard all quads of the current frame.
+    void Clear() {
+        m_count = 0U;
+        m_quads = 0U;
+    }
+    
+    /// Current ammount of quads in the frame.
+    size_t QuadCount() const {
+        return m_quads;
+    }
+    
+    /// Current ammount of batches in the frame.
+    size_t BatchCount() const {
+        return m_count;
+    }
+    
+    /// Ammount of draw calls of the previous Draw().
+    size_t DrawCalls() const {
+        return m_drawcalls;
+    }
+    
+    Compositor() {
+        m_count = 0U;
+        m_quads = 0U;
+        m_drawcalls = 0U;
+    }
+    
+    ~Compositor() {}
+    
+};
+
+}
\ No newline at end of file
@@ -4,27 +4,56 @@
 #include "Updatable.hpp"
 #include "Drawable.hpp"
 #include "Collection.hpp"
+#include "Compositor.hpp"
+#include "SpatialIndex.hpp"
+#include "ThreadPool.hpp"
+#include "UpdateBatch.hpp"
+#include "Profiler.hpp"
 #include "Event.hpp"
 
 #include <SFML/Graphics.hpp>
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
 
 namespace cf {
 
+class InputRouter;
+
 /// Base type for an updatable and drawable object, with child objects.
 class Control : public Updatable, public Drawable, public ObjectOwner {
 
 private:
     
+    friend class InputRouter;
+    
     Collection<Updatable> m_updatables;
     Collection<Drawable> m_drawables;
+    std::vector<Updatable*> m_removedupdatables;
+    std::vector<Drawable*> m_removeddrawables;
+    Compositor m_compositor;
+    SpatialIndex<Drawable> m_index;
+    std::vector<Drawable*> m_visible;
+    size_t m_culled;
+    std::shared_ptr<ThreadPool> m_pool;
+    UpdateBatch m_batch;
+    std::mutex m_mutex;
+    std::shared_ptr<Profiler> m_profiler;
     
 protected:
     
     /// Background color of the control.
     sf::Color m_background;
     
+    /// Focus mode. If true, the control takes the keyboard focus when it is clicked. Otherwise, clicks focus the closest focusable owner control.
+    bool m_focusable;
+    
+    /// Input router of the control's form, e.g. to take the focus or to check the hovered control. Include "CForms/InputRouter.hpp" to use it.
+    /// Null until the control was created by a form or control.
+    std::shared_ptr<cf::InputRouter> m_input;
+    
 public:
     
     /// Fired when the control's background color was changed, through SetBackground().
@@ -36,36 +65,73 @@ private:
     
     /// Internal handler call to manage position changes of drawable child objects.
     void __OnObjectPositionChanged(Drawable*, const sf::Vector2f& position) {
+        std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+        if (m_pool) lock.lock();
         m_dirty = true;
     }
     
+    /// Internal handler call to index moved or resized drawable child objects.
+    void __OnObjectBoundsChanged(Drawable* drawable, const sf::FloatRect& previous, const sf::FloatRect& bounds) {
+        std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+        if (m_pool) lock.lock();
+        m_index.Update(drawable, bounds);
+    }
+    
+    /// Internal handler call to compact the collections after a batch of deferred deletions.
+    void __OnPendingFlushed(ObjectOwner* sender) {
+        m_updatables.RemoveAll(std::move(m_removedupdatables));
+        m_drawables.RemoveAll(std::move(m_removeddrawables));
+        m_removedupdatables.clear();
+        m_removeddrawables.clear();
+    }
+    
     /// Internal handler call to manage created updatable and drawable child objects.
     void __OnObjectCreated(ObjectOwner* sender, Object*& object) {
+        if (m_profiler) m_profiler->Register(object);
         if (ObjectOwner* owner = dynamic_cast<ObjectOwner*>(object)) {
             Register<ObjectOwner>(owner);
         }
         if (Control* control = dynamic_cast<Control*>(object)) {
             Register<Control>(control);
+            if (m_pool) control->__SetPool(m_pool);
+            if (m_profiler) control->__SetProfiler(m_profiler);
+            if (m_input) control->__SetInput(m_input);
         }
         if (cf::Updatable* updatable = dynamic_cast<cf::Updatable*>(object)) {
             Register<Updatable>(updatable);
             m_updatables.Add(updatable);
+            m_batch.Add(updatable);
+            if (m_scheduler) updatable->__SetScheduler(m_scheduler);
+            if (m_animator) updatable->__SetAnimator(m_animator);
         }
         if (cf::Drawable* drawable = dynamic_cast<cf::Drawable*>(object)) {
             Register<Drawable>(drawable);
             m_drawables.Add(drawable);
             drawable->PositionChanged.Bind(&Control::__OnObjectPositionChanged, this);
+            drawable->BoundsChanged.Bind(&Control::__OnObjectBoundsChanged, this);
+            m_index.Insert(drawable, drawable->Bounds());
+            if (m_atlas) drawable->__SetAtlas(m_atlas, m_layer + 1U);
+            if (m_timestep) drawable->__SetTimestep(m_timestep);
+            // children created inside a transaction join it
+            if (m_layoutdepth != 0U) drawable->SuspendLayout();
         }
     }
     
     /// Internal handler call to manage deleted updatable and drawable child objects.
     void __OnObjectDeleted(ObjectOwner* sender, Object*& object) {
+        if (m_profiler) m_profiler->Unregister(object);
         if (cf::Updatable* updatable = dynamic_cast<cf::Updatable*>(object)) {
-            m_updatables.Remove(updatable);
+            if (IsFlushing()) m_removedupdatables.push_back(updatable);
+            else m_updatables.Remove(updatable);
+            m_batch.Remove(updatable);
         }
         if (cf::Drawable* drawable = dynamic_cast<cf::Drawable*>(object)) {
-            m_drawables.Remove(drawable);
+            if (IsFlushing()) m_removeddrawables.push_back(drawable);
+            else m_drawables.Remove(drawable);
             drawable->PositionChanged.Unbind(&Control::__OnObjectPositionChanged, this);
+            drawable->BoundsChanged.Unbind(&Control::__OnObjectBoundsChanged, this);
+            m_index.Remove(drawable);
+            m_dirty = true;
         }
     }
     
@@ -81,40 +147,86 @@ protected:
     
     /// Override this call to draw your control
     virtual void Draw() override {
-        m_canvas.clear(m_background);
+        Clear(m_background);
+    }
+    
+    /// Override this to handle mouse and keyboard input routed to the control by its form.
+    /// Mouse coordinates are relative to the control. MouseEntered, MouseLeft, GainedFocus and LostFocus report hover and focus changes of the control.
+    /// Use DeleteLater() to delete controls from here.
+    /// @return True if the input was handled. Otherwise, mouse, key and text input is passed on to the owner control.
+    virtual bool InputEvent(sf::Event& input_event) {
+        return false;
     }
     
 public:
     
     /// Internal Update() call of the control.
     virtual void __UpdateCall(const sf::Time& delta) override {
-        Update(delta);
-        for (auto& updatable : m_updatables) {
-            if (updatable->Error() != 0U) continue;
-            updatable->__UpdateCall(delta);
+        {
+            Profiler::Scope scope(m_profiler.get(), this, Profiler::UpdateSelf);
+            Update(delta);
         }
+        m_batch.Run(delta, m_pool.get(), m_profiler.get());
+    }
+    
+    /// Internal call to update the child objects of the control in parallel, on the thread pool of its form.
+    void __SetPool(std::shared_ptr<ThreadPool> pool) {
+        m_pool = pool;
+    }
+    
+    /// Internal call to share the input router of the form with the control.
+    void __SetInput(const std::shared_ptr<InputRouter>& input) {
+        m_input = input;
+    }
+    
+    /// Internal call to record the timings of the control's child objects in the profiler of its form.
+    void __SetProfiler(std::shared_ptr<Profiler> profiler) {
+        m_profiler = profiler;
     }
     
     /// Internal Draw() call of the control.
+    /// Children outside of the control's canvas are neither drawn nor composited.
     virtual void __DrawCall() override {
-        for (auto& drawable : m_drawables) {
+        m_index.Query(sf::FloatRect(0.0f, 0.0f, float(m_transform.Width()), float(m_transform.Height())), m_visible);
+        m_culled = m_drawables.Count() - m_visible.size();
+        for (auto& drawable : m_visible) {
             if (drawable->Error() != 0U) continue;
             if (drawable->IsDirty()) m_dirty = true;
+            Profiler::Scope scope(m_profiler.get(), drawable, Profiler::DrawTotal);
             drawable->__DrawCall();
         }
-        if (m_dirty) {
-            Draw();
-            for (auto& drawable : m_drawables) {
+        if (IsDirty()) {
+            __BeginDraw();
+            {
+                Profiler::Scope scope(m_profiler.get(), this, Profiler::DrawSelf);
+                Draw();
+            }
+            Profiler::Scope scope(m_profiler.get(), this, Profiler::Composite);
+            for (auto& drawable : m_visible) {
                 if (drawable->Error() != 0U) continue;
-                sf::Sprite sprite(drawable->Canvas()->getTexture());
-                sprite.setPosition(sf::Vector2f(drawable->Transform()->Position()));
-                m_canvas.draw(sprite);
+                m_compositor.Add(drawable->Canvas()->getTexture(), drawable->TextureRect(), drawable->Transform()->Position());
             }
-            m_canvas.display();
+            m_compositor.Draw(*Canvas());
+            __EndDraw();
             m_dirty = false;
         }
     }
     
+    /// All drawable child objects intersecting the given area, in control coordinates and drawing order.
+    std::vector<Drawable*> QueryRegion(const sf::FloatRect& rect) {
+        return m_index.Query(rect);
+    }
+    
+    /// Ammount of drawable child objects skipped in the previous draw call, because they were outside of the control's canvas.
+    size_t CulledCount() const {
+        return m_culled;
+    }
+    
+    /// Topmost drawable child object at the given position, in control coordinates. Null if there is none.
+    Drawable* HitTest(const sf::Vector2f& point) {
+        return m_index.QueryTopmost(point, [](Drawable* drawable) { return drawable->Error() == 0U; });
+    }
+    
     /// Current background color of the control 
     virtual const sf::Color& Background() const {
         return m_background;
@@ -127,11 +239,30 @@ public:
         BackgroundChanged(this, m_background);
     }
     
+    /// Start collecting transform changes of the control and all of its drawable child objects, e.g. to resize a whole subtree at once.
+    virtual void SuspendLayout() override {
+        if (m_layoutdepth == 0U) {
+            for (size_t i = 0; i < m_drawables.Count(); ++i) m_drawables[i]->SuspendLayout();
+        }
+        Drawable::SuspendLayout();
+    }
+    
+    /// Finish a SuspendLayout() call. After the outermost one, child objects report their changes first, while the control still collects its own.
+    virtual void ResumeLayout() override {
+        if (m_layoutdepth == 1U) {
+            for (size_t i = 0; i < m_drawables.Count(); ++i) m_drawables[i]->ResumeLayout();
+        }
+        Drawable::ResumeLayout();
+    }
+    
     /// Do not use constructors to create a control! Instead, use Create() from the object owner.
     Control(ObjectOwner* owner, const std::string& name) : Object(owner, name) {
         m_background = sf::Color(0x000000FF);
+        m_focusable = false;
+        m_culled = 0U;
         ObjectCreated.Bind(&cf::Control::__OnObjectCreated, this);
         ObjectDeleted.Bind(&cf::Control::__OnObjectDeleted, this);
+        PendingFlushed.Bind(&cf::Control::__OnPendingFlushed, this);
     }
     
     /// Do not use constructors to create a control! Instead, use Create() from the object owner.
@@ -141,6 +272,7 @@ public:
     virtual ~Control() {
         ObjectCreated.Unbind(&cf::Control::__OnObjectCreated, this);
         ObjectDeleted.Unbind(&cf::Control::__OnObjectDeleted, this);
+        PendingFlushed.Unbind(&cf::Control::__OnPendingFlushed, this);
     }
     
 };
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace cf {
+
+/// Storage type for the areas of a cf::Form, which have to be redrawn.
+/// Overlapping rectangles are merged. Too many rectangles are collapsed into their bounding box.
+class DamageRegion {
+
+private:
+    
+    std::vector<sf::FloatRect> m_rects;
+    size_t m_limit;
+    
+private:
+    
+    /// Internal call to get the bounding box of two rectangles.
+    static sf::FloatRect __Union(const sf::FloatRect& a, const sf::FloatRect& b) {
+        float left = std::min(a.left, b.left);
+        float top = std::min(a.top, b.top);
+        float right = std::max(a.left + a.width, b.left + b.width);
+        float bottom = std::max(a.top + a.height, b.top + b.height);
+        return sf::FloatRect(left, top, right - left, bottom - top);
+    }
+    
+    /// Internal call to check whether two rectangles overlap or touch.
+    static bool __Touches(const sf::FloatRect& a, const sf::FloatRect& b) {
+        return a.left <= b.left + b.width && b.left <= a.left + a.width
+            && a.top <= b.top + b.height && b.top <= a.top + a.height;
+    }
+    
+public:
+    
+    /// Add a damaged rectangle. It is expanded to whole pixels.
+    void Add(const sf::FloatRect& rect) {
+        if (rect.width <= 0.0f || rect.height <= 0.0f) return;
+        float left = std::floor(rect.left);
+        float top = std::floor(rect.top);
+        sf::FloatRect merged(left, top, std::ceil(rect.left + rect.width) - left, std::ceil(rect.top + rect.height) - top);
+        for (size_t i = 0; i < m_rects.size();) {
+            if (__Touches(merged, m_rects[i])) {
+                merged = __Union(merged, m_rects[i]);
+                m_rects[i] = m_rects.back();
+                m_rects.pop_back();
+                i = 0;
+                continue;
+            }
+            ++i;
+        }
+        m_rects.push_back(merged);
+        if (m_rects.size() > m_limit) {
+            sf::FloatRect bounds = Bounds();
+            m_rects.clear();
+            m_rects.push_back(bounds);
+        }
+    }
+    
+    /// Remove all damaged rectangles.
+    void Clear() {
+        m_rects.clear();
+    }
+    
+    /// True if nothing is damaged.
+    bool IsEmpty() const {
+        return m_rects.empty();
+    }
+    
+    /// Check whether the given rectangle overlaps a damaged rectangle.
+    bool Intersects(const sf::FloatRect& rect) const {
+        for (const auto& inner : m_rects) {
+            if (inner.intersects(rect)) return true;
+        }
+        return false;
+    }
+    
+    /// Bounding box of all damaged rectangles.
+    sf::FloatRect Bounds() const {
+        if (m_rects.empty()) return sf::FloatRect();
+        sf::FloatRect bounds = m_rects[0];
+        for (const auto& inner : m_rects) {
+            bounds = __Union(bounds, inner);
+        }
+        return bounds;
+    }
+    
+    /// Current damaged rectangles. They do not overlap each other.
+    const std::vector<sf::FloatRect>& Rects() const {
+        return m_rects;
+    }
+    
+    /// @param limit Maximum ammount of separate rectangles, before they are collapsed into their bounding box.
+    DamageRegion(size_t limit) {
+        m_limit = std::max<size_t>(limit, 1U);
+    }
+    
+    DamageRegion() : DamageRegion(16U) {}
+    
+    ~DamageRegion() {}
+    
+};
+
+}
\ No newline at end of file
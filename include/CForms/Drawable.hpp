@@ -3,10 +3,13 @@
 #include "Object.hpp"
 #include "Transform.hpp"
 #include "Event.hpp"
+#include "Atlas.hpp"
+#include "Timestep.hpp"
 
 #include <SFML/Graphics.hpp>
 
 #include <iostream>
+#include <memory>
 
 namespace cf {
 
@@ -16,14 +19,38 @@ class Drawable : public virtual Object {
 protected:
     
     /// SFML render texture of the object.
+    /// Unused if the object was placed inside a form atlas. Draw through Canvas() and Clear() instead.
     sf::RenderTexture m_canvas;
     
+    /// Shared atlas of the form, if atlas mode is enabled.
+    std::shared_ptr<cf::Atlas> m_atlas;
+    
+    /// Region of the object inside the form atlas. Null if the object uses its own render texture.
+    AtlasRegion* m_region;
+    
+    /// Nesting layer of the object inside the form atlas.
+    uint32_t m_layer;
+    
+    /// Shared timestep of the form. Null until the object was created by a form or control.
+    std::shared_ptr<const cf::Timestep> m_timestep;
+    
     /// Position and size of the object.
     cf::Transform m_transform;
     
     /// Dirty state of the object. If true at draw time, the object will be redrawn.
     bool m_dirty;
     
+    /// Bounds of the object, as reported through BoundsChanged.
+    sf::FloatRect m_bounds;
+    
+    /// Nesting depth of SuspendLayout() calls. While not 0, transform changes are collected instead of reported.
+    uint32_t m_layoutdepth;
+    
+private:
+    
+    bool m_layoutmoved;
+    bool m_layoutresized;
+    
 public:
     
     /// Fired when the object's transform position was changed, through Transform().
@@ -36,22 +63,57 @@ public:
     /// @param size New transform size.
     Event<Drawable*, const sf::Vector2u&> SizeChanged;
     
+    /// Fired when the object's bounds were changed, through Transform().
+    /// @param sender Object which fired the event.
+    /// @param previous Bounds before the change.
+    /// @param bounds New bounds.
+    Event<Drawable*, const sf::FloatRect&, const sf::FloatRect&> BoundsChanged;
+    
 private:
     
+    /// Internal call to report the previous and new bounds of the object.
+    void __ReportBounds() {
+        sf::FloatRect previous = m_bounds;
+        m_bounds = Bounds();
+        if (previous == m_bounds) return;
+        BoundsChanged(this, previous, m_bounds);
+    }
+    
+    /// Internal call to reallocate the object's canvas area for a new size.
+    bool __ResizeCanvas(const sf::Vector2u& size) {
+        if (m_atlas) {
+            if (m_region) m_atlas->Free(m_region);
+            m_region = m_atlas->Allocate(size, m_layer);
+            if (m_region) return true;
+        }
+        if (!m_canvas.create(size.x, size.y)) {
+            std::cout << "[X] '" + m_name + "': Failed to recreate object canvas, after size change.\n";
+            m_error = 2U;
+            ErrorEncoutered(this, m_error);
+            return false;
+        }
+        return true;
+    }
+    
     /// Internal handler call to report changes of the object's transform position.
     void __OnTransformPositionChanged(const sf::Vector2f& position) {
+        if (m_layoutdepth != 0U) {
+            m_layoutmoved = true;
+            return;
+        }
+        __ReportBounds();
         PositionChanged(this, position);
     }
     
     /// Internal handler call to report changes of the object's transform size.
     void __OnTransformSizeChanged(const sf::Vector2u& size) {
-        if (!m_canvas.create(size.x, size.y)) {
-            std::cout << "[X] '" + m_name + "': Failed to recreate object canvas, after size change.\n";
-            m_error = 2U;
-            ErrorEncoutered(this, m_error);
+        if (m_layoutdepth != 0U) {
+            m_layoutresized = true;
             return;
         }
+        if (!__ResizeCanvas(size)) return;
         m_dirty = true;
+        __ReportBounds();
         SizeChanged(this, size);
     }
     
@@ -60,6 +122,10 @@ protected:
     /// Override this to initialize your object.
     /// Call Drawable::Init() to create the object's render texture, if you override!
     virtual bool Init() override {
+        if (m_atlas) {
+            if (!m_region) m_region = m_atlas->Allocate(m_transform.Size(), m_layer);
+            if (m_region) return true;
+        }
         if (!m_canvas.create(m_transform.Width(), m_transform.Height())) {
             // ERROR Failed to create canvas
             std::cerr << "[X] '" + m_name + "': Failed to create canvas\n";
@@ -71,29 +137,101 @@ protected:
     /// Override this call to draw your object
     virtual void Draw() {}
     
+    /// Progress from the previous towards the next fixed update step of the form, between 0 and 1, to interpolate drawing.
+    /// Always 1 if the form has no fixed timestep. Objects have to stay dirty to be redrawn between update steps.
+    float Alpha() const {
+        return m_timestep ? m_timestep->Alpha() : 1.0f;
+    }
+    
+    /// Clear the object's canvas area with the given color.
+    /// Use this instead of m_canvas.clear(), to support objects inside a form atlas.
+    void Clear(const sf::Color& color) {
+        if (!m_region) {
+            m_canvas.clear(color);
+            return;
+        }
+        sf::RectangleShape shape(sf::Vector2f(m_region->rect.width, m_region->rect.height));
+        shape.setFillColor(color);
+        m_region->page->draw(shape, sf::RenderStates(sf::BlendNone));
+    }
+    
+    /// Internal call to prepare the object's canvas area for drawing.
+    /// Inside a form atlas, the page view is mapped onto the object's region, so drawing uses local coordinates.
+    void __BeginDraw() {
+        if (!m_region) return;
+        m_region->relocated = false;
+        sf::Vector2f pagesize(m_region->page->getSize());
+        sf::FloatRect rect(m_region->rect);
+        sf::View view(sf::FloatRect(0.0f, 0.0f, rect.width, rect.height));
+        view.setViewport(sf::FloatRect(rect.left / pagesize.x, rect.top / pagesize.y, rect.width / pagesize.x, rect.height / pagesize.y));
+        m_region->page->setView(view);
+    }
+    
+    /// Internal call to finish drawing of the object's canvas area.
+    void __EndDraw() {
+        Canvas()->display();
+    }
+    
 public:
     
     /// Internal Draw() call of the object.
     virtual void __DrawCall() {
-        if (m_dirty) {
+        if (IsDirty()) {
+            __BeginDraw();
             Draw();
+            __EndDraw();
             m_dirty = false;
         }
     }
     
+    /// Internal call to place the object inside a form atlas. Must happen before initialization.
+    /// @param atlas Shared atlas of the form.
+    /// @param layer Nesting layer of the object. Objects are never composited into pages of their own layer.
+    void __SetAtlas(const std::shared_ptr<cf::Atlas>& atlas, uint32_t layer) {
+        if (m_region) return;
+        m_atlas = atlas;
+        m_layer = layer;
+    }
+    
+    /// Internal call to take over bounds changed in bulk by a cf::TransformStore, without reporting them.
+    /// @return Bounds before the change.
+    sf::FloatRect __SyncBounds() {
+        sf::FloatRect previous = m_bounds;
+        m_bounds = Bounds();
+        return previous;
+    }
+    
+    /// Internal call to share the timestep of the form with the object.
+    void __SetTimestep(const std::shared_ptr<const cf::Timestep>& timestep) {
+        m_timestep = timestep;
+    }
+    
     /// Reference pointer to the object's transform.
     virtual cf::Transform* Transform() {
         return &m_transform;
     }
     
     /// Reference pointer to the object's SFML render texture. 
+    /// Inside a form atlas, this is the shared page which contains TextureRect().
     virtual sf::RenderTexture* Canvas() {
+        if (m_region) return m_region->page;
         return &m_canvas;
     }
     
+    /// Current bounds of the object, inside its owner.
+    sf::FloatRect Bounds() const {
+        return sf::FloatRect(m_transform.Position(), sf::Vector2f(m_transform.Size()));
+    }
+    
+    /// Pixel rectangle of the object's contents inside Canvas().
+    virtual sf::IntRect TextureRect() const {
+        if (m_region) return m_region->rect;
+        return sf::IntRect(0, 0, m_transform.Width(), m_transform.Height());
+    }
+    
     /// True if the object needs to be redrawn.
     virtual bool IsDirty() const {
-        return m_dirty;
+        return m_dirty || (m_region && m_region->relocated);
     }
     
     /// Change your object's dirty state.
@@ -101,6 +239,34 @@ public:
         m_dirty = dirty;
     }
     
+    /// True while transform changes of the object are collected, between SuspendLayout() and ResumeLayout().
+    bool IsLayoutSuspended() const {
+        return m_layoutdepth != 0U;
+    }
+    
+    /// Start collecting transform changes of the object, instead of reporting each one. Calls can be nested.
+    /// The canvas is not reallocated until the matching ResumeLayout(), so Canvas() keeps its previous size meanwhile.
+    virtual void SuspendLayout() {
+        m_layoutdepth++;
+    }
+    
+    /// Finish a SuspendLayout() call. After the outermost one, collected transform changes are applied and reported once:
+    /// one canvas reallocation, then BoundsChanged, SizeChanged and PositionChanged with the final values.
+    virtual void ResumeLayout() {
+        if (m_layoutdepth == 0U || --m_layoutdepth != 0U) return;
+        bool moved = m_layoutmoved;
+        bool resized = m_layoutresized;
+        m_layoutmoved = false;
+        m_layoutresized = false;
+        if (resized) {
+            if (!__ResizeCanvas(m_transform.Size())) return;
+            m_dirty = true;
+        }
+        if (moved || resized) __ReportBounds();
+        if (resized) SizeChanged(this, m_transform.Size());
+        if (moved) PositionChanged(this, m_transform.Position());
+    }
+    
     /// Do not use this constructor!
     /// Types derived from cf::Drawable should call cf::Object(owner, name) or cf::Object(name) on their constructor!
     Drawable() {
@@ -108,11 +274,18 @@ public:
         m_transform.__PositionChanged.Bind(&Drawable::__OnTransformPositionChanged, this);
         m_transform.__SizeChanged.Bind(&Drawable::__OnTransformSizeChanged, this);
         m_dirty = true;
+        m_bounds = Bounds();
+        m_region = nullptr;
+        m_layer = 0U;
+        m_layoutdepth = 0U;
+        m_layoutmoved = false;
+        m_layoutresized = false;
     }
     
     virtual ~Drawable() {
         m_transform.__PositionChanged.Unbind(&Drawable::__OnTransformPositionChanged, this);
         m_transform.__SizeChanged.Unbind(&Drawable::__OnTransformSizeChanged, this);
+        if (m_region) m_atlas->Free(m_region);
     }
     
 };
@@ -1,285 +1,368 @@
 #pragma once
 
-#include <typeinfo>
-#include <functional>
-#include <stdexcept>
-#include <memory>
+#include <new>
 #include <atomic>
+#include <thread>
 #include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
 
 namespace cf {
 
 /// Event handling type to manage changes of object properties.
+/// Invoking an event is lock-free and does not allocate. Subscribers may be bound and unbound while the event is invoked.
+/// An invocation running on another thread may still call a handler, which was just unbound.
 template <typename... Args>
 class Event {
 
 private:
     
-    typedef typename std::function<void(Args ...)> Closure;
-    
-    struct ComparableClosure {
+    /// Small-buffer callable. Member functions, free functions and small lambdas are stored inline.
+    struct Delegate {
         
-        Closure Callable;
-        void *Object;
-        uint8_t *Functor;
-        int FunctorSize;
+        static constexpr size_t BufferSize = 4 * sizeof(void*);
         
-        ComparableClosure(const ComparableClosure &) = delete;
+        typedef void(*Invoker)(const Delegate&, Args&...);
+        typedef void(*Manager)(Delegate&, const Delegate*);
         
-        ComparableClosure() : Object(nullptr), Functor(nullptr), FunctorSize(0) {}
+        alignas(std::max_align_t) uint8_t Buffer[BufferSize];
+        Invoker Invoke;
+        Manager Manage;
+        size_t KeySize;
         
-        ComparableClosure(Closure &&closure) : Callable(std::move(closure)), Object(nullptr), Functor(nullptr), FunctorSize(0) {}
+        Delegate() : Invoke(nullptr), Manage(nullptr), KeySize(0) {
+            std::memset(Buffer, 0, BufferSize);
+        }
         
-        ~ComparableClosure() {
-            if (Functor != nullptr)
-                delete[] Functor;
+        Delegate(const Delegate &delegate) : Delegate() {
+            (*this) = delegate;
         }
         
-        ComparableClosure & operator=(const ComparableClosure &closure) {
-            Callable = closure.Callable;
-            Object = closure.Object;
-            FunctorSize = closure.FunctorSize;
-            if (closure.FunctorSize == 0) {
-                Functor = nullptr;
-            }
-            else {
-                Functor = new uint8_t[closure.FunctorSize];
-                std::memcpy(Functor, closure.Functor, closure.FunctorSize);
-            }
+        ~Delegate() {
+            if (Manage != nullptr)
+                Manage(*this, nullptr);
+        }
+        
+        Delegate & operator=(const Delegate &delegate) {
+            if (this == &delegate)
+                return *this;
+            
+            if (Manage != nullptr)
+                Manage(*this, nullptr);
+            
+            Invoke = delegate.Invoke;
+            Manage = delegate.Manage;
+            KeySize = delegate.KeySize;
+            if (Manage != nullptr)
+                Manage(*this, &delegate);
+            else
+                std::memcpy(Buffer, delegate.Buffer, BufferSize);
+            
             return *this;
         }
         
-        bool operator==(const ComparableClosure &closure) {
-            if (Object == nullptr && closure.Object == nullptr) {
-                return Callable.target_type() == closure.Callable.target_type();
-            }
-            else {
-                return Object == closure.Object && FunctorSize == closure.FunctorSize
-                    && std::memcmp(Functor, closure.Functor, FunctorSize) == 0;
-            }
+        /// Member functions and free functions compare by their object and function. Lambdas compare by their type.
+        bool operator==(const Delegate &delegate) const {
+            return Invoke == delegate.Invoke && KeySize == delegate.KeySize
+                && std::memcmp(Buffer, delegate.Buffer, KeySize) == 0;
+        }
+    };
+    
+    template <typename Ref>
+    struct MemberBinding {
+        Ref *Object;
+        void(Ref::*Function)(Args...);
+    };
+    
+    typedef void(*FreeBinding)(Args...);
+    
+    template <typename F>
+    static constexpr bool isInline() {
+        return sizeof(F) <= Delegate::BufferSize && alignof(F) <= alignof(std::max_align_t)
+            && std::is_trivially_copyable<F>::value && std::is_trivially_destructible<F>::value;
+    }
+    
+    template <typename Ref>
+    static void invokeMember(const Delegate &delegate, Args&... args) {
+        auto &binding = *reinterpret_cast<const MemberBinding<Ref>*>(delegate.Buffer);
+        (binding.Object->*binding.Function)(args...);
+    }
+    
+    static void invokeFree(const Delegate &delegate, Args&... args) {
+        (*reinterpret_cast<const FreeBinding*>(delegate.Buffer))(args...);
+    }
+    
+    template <typename F>
+    static void invokeInline(const Delegate &delegate, Args&... args) {
+        (*reinterpret_cast<F*>(const_cast<uint8_t*>(delegate.Buffer)))(args...);
+    }
+    
+    template <typename F>
+    static void invokeHeap(const Delegate &delegate, Args&... args) {
+        (**reinterpret_cast<F* const*>(delegate.Buffer))(args...);
+    }
+    
+    /// Copies the heap closure of source into target, or destroys the closure of target if source is nullptr.
+    template <typename F>
+    static void manageHeap(Delegate &target, const Delegate *source) {
+        F *&closure = *reinterpret_cast<F**>(target.Buffer);
+        if (source == nullptr) {
+            delete closure;
+            closure = nullptr;
+        }
+        else {
+            closure = new F(**reinterpret_cast<F* const*>(source->Buffer));
+        }
+    }
+    
+    template <typename Ref>
+    static Delegate makeDelegate(void(Ref::*function)(Args...), Ref *object) {
+        static_assert(sizeof(MemberBinding<Ref>) <= Delegate::BufferSize, "Member function pointer does not fit into a delegate");
+        Delegate delegate;
+        new (delegate.Buffer) MemberBinding<Ref>{object, function};
+        delegate.Invoke = &invokeMember<Ref>;
+        delegate.KeySize = sizeof(MemberBinding<Ref>);
+        return delegate;
+    }
+    
+    static Delegate makeDelegate(void(*function)(Args...)) {
+        Delegate delegate;
+        new (delegate.Buffer) FreeBinding(function);
+        delegate.Invoke = &invokeFree;
+        delegate.KeySize = sizeof(FreeBinding);
+        return delegate;
+    }
+    
+    template <typename F>
+    static Delegate makeClosure(F &&f) {
+        typedef typename std::decay<F>::type Closure;
+        Delegate delegate;
+        if constexpr (isInline<Closure>()) {
+            new (delegate.Buffer) Closure(std::forward<F>(f));
+            delegate.Invoke = &invokeInline<Closure>;
+        }
+        else {
+            new (delegate.Buffer) Closure*(new Closure(std::forward<F>(f)));
+            delegate.Invoke = &invokeHeap<Closure>;
+            delegate.Manage = &manageHeap<Closure>;
+        }
+        return delegate;
+    }
+    
+    /// Immutable snapshot of all subscribers. Replaced as a whole by writers, so readers never see a partial change.
+    struct DelegateList {
+        
+        Delegate *Delegates;
+        size_t Count;
+        DelegateList *Next;
+        
+        DelegateList(size_t count) : Delegates(new Delegate[count]), Count(count), Next(nullptr) {}
+        
+        ~DelegateList() {
+            delete[] Delegates;
         }
     };
     
-    struct ClosureList {
+    /// Keeps the current snapshot alive while it is invoked.
+    struct ReadGuard {
         
-        ComparableClosure *Closures;
-        int Count;
+        std::atomic<uint32_t> &Readers;
         
-        ClosureList(ComparableClosure *closures, int count) {
-            Closures = closures;
-            Count = count;
+        ReadGuard(std::atomic<uint32_t> &readers) : Readers(readers) {
+            Readers.fetch_add(1);
         }
         
-        ~ClosureList() {
-            delete[] Closures;
+        ~ReadGuard() {
+            Readers.fetch_sub(1);
         }
     };
     
-    typedef std::shared_ptr<ClosureList> ClosureListPtr;
+    /// Serializes writers. Readers are never blocked.
+    struct WriteGuard {
+        
+        std::atomic_flag &Writing;
+        
+        WriteGuard(std::atomic_flag &writing) : Writing(writing) {
+            while (Writing.test_and_set(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+        
+        ~WriteGuard() {
+            Writing.clear(std::memory_order_release);
+        }
+    };
     
 private:
     
-    ClosureListPtr m_events;
+    std::atomic<DelegateList*> m_events;
+    std::atomic<uint32_t> m_readers;
+    std::atomic_flag m_writing = ATOMIC_FLAG_INIT;
+    DelegateList *m_retired;
     
 private:
     
-    bool addClosure(const ComparableClosure &closure) {
-        auto events = std::atomic_load(&m_events);
-        int count;
-        ComparableClosure *closures;
-        if (events == nullptr) {
-            count = 0;
-            closures = nullptr;
-        }
-        else {
-            count = events->Count;
-            closures = events->Closures;
+    /// Publishes a new snapshot. Previous snapshots are freed as soon as no invocation can reference them.
+    /// The write guard has to be held.
+    void replaceEvents(DelegateList *events) {
+        auto previous = m_events.exchange(events);
+        if (previous != nullptr) {
+            previous->Next = m_retired;
+            m_retired = previous;
         }
-        auto newCount = count + 1;
-        auto newClosures = new ComparableClosure[newCount];
-        if (count != 0) {
-            for (int i = 0; i < count; i++)
-                newClosures[i] = closures[i];
+        if (m_readers.load() != 0)
+            return;
+        
+        while (m_retired != nullptr) {
+            auto next = m_retired->Next;
+            delete m_retired;
+            m_retired = next;
         }
-        newClosures[count] = closure;
-        auto newEvents = ClosureListPtr(new ClosureList(newClosures, newCount));
-        if (std::atomic_compare_exchange_weak(&m_events, &events, newEvents))
-            return true;
+    }
+    
+    /// Deep copy of the current snapshot. The write guard has to be held.
+    DelegateList * copyEvents() const {
+        auto events = m_events.load();
+        if (events == nullptr)
+            return nullptr;
+        
+        auto copy = new DelegateList(events->Count);
+        for (size_t i = 0; i < events->Count; i++)
+            copy->Delegates[i] = events->Delegates[i];
+        
+        return copy;
+    }
+    
+    void addDelegate(const Delegate &delegate) {
+        WriteGuard guard(m_writing);
+        auto events = m_events.load();
+        size_t count = events == nullptr ? 0 : events->Count;
+        auto newEvents = new DelegateList(count + 1);
+        for (size_t i = 0; i < count; i++)
+            newEvents->Delegates[i] = events->Delegates[i];
         
-        return false;
+        newEvents->Delegates[count] = delegate;
+        replaceEvents(newEvents);
     }
     
-    bool removeClosure(const ComparableClosure &closure) {
-        auto events = std::atomic_load(&m_events);
+    void removeDelegate(const Delegate &delegate) {
+        WriteGuard guard(m_writing);
+        auto events = m_events.load();
         if (events == nullptr)
-            return true;
+            return;
         
-        int index = -1;
-        auto count = events->Count;
-        auto closures = events->Closures;
-        for (int i = 0; i < count; i++) {
-            if (closures[i] == closure) {
+        size_t index = events->Count;
+        for (size_t i = 0; i < events->Count; i++) {
+            if (events->Delegates[i] == delegate) {
                 index = i;
                 break;
             }
         }
-        if (index == -1)
-            return true;
+        if (index == events->Count)
+            return;
         
-        auto newCount = count - 1;
-        ClosureListPtr newEvents;
-        if (newCount == 0) {
-            newEvents = nullptr;
-        }
-        else {
-            auto newClosures = new ComparableClosure[newCount];
-            for (int i = 0; i < index; i++)
-                newClosures[i] = closures[i];
-            
-            for (int i = index + 1; i < count; i++)
-                newClosures[i - 1] = closures[i];
-            
-            newEvents = ClosureListPtr(new ClosureList(newClosures, newCount));
+        DelegateList *newEvents = nullptr;
+        if (events->Count > 1) {
+            newEvents = new DelegateList(events->Count - 1);
+            for (size_t i = 0, j = 0; i < events->Count; i++) {
+                if (i != index)
+                    newEvents->Delegates[j++] = events->Delegates[i];
+            }
         }
-    
-        if (std::atomic_compare_exchange_weak(&m_events, &events, newEvents))
-            return true;
-        
-        return false;
+        replaceEvents(newEvents);
     }
     
 public:
     
-    Event() {
-        atomic_store(&m_events, ClosureListPtr());
-    }
+    Event() : m_events(nullptr), m_readers(0), m_retired(nullptr) {}
     
-    Event(const Event &event) {
-        std::atomic_store(&m_events, std::atomic_load(&event.m_events));
+    Event(const Event &event) : Event() {
+        (*this) = event;
     }
     
     ~Event() {
-        (*this) = nullptr;
+        delete m_events.load();
+        while (m_retired != nullptr) {
+            auto next = m_retired->Next;
+            delete m_retired;
+            m_retired = next;
+        }
     }
     
     void operator =(const Event &event) {
-        std::atomic_store(&m_events, std::atomic_load(&event.m_events));
+        if (this == &event)
+            return;
+        
+        DelegateList *copy;
+        {
+            WriteGuard guard(const_cast<Event&>(event).m_writing);
+            copy = event.copyEvents();
+        }
+        WriteGuard guard(m_writing);
+        replaceEvents(copy);
     }
     
     void operator=(std::nullptr_t nullpointer) {
-        while (true) {
-            auto events = std::atomic_load(&m_events);
-            if (!std::atomic_compare_exchange_weak(&m_events, &events, ClosureListPtr()))
-                continue;
-            
-            break;
-        }
+        WriteGuard guard(m_writing);
+        replaceEvents(nullptr);
     }
     
     bool operator==(std::nullptr_t nullpointer) {
-        auto events = std::atomic_load(&m_events);
-        return events == nullptr;
+        return m_events.load() == nullptr;
     }
     
     bool operator!=(std::nullptr_t nullpointer) {
-        auto events = std::atomic_load(&m_events);
-        return events != nullptr;
+        return m_events.load() != nullptr;
     }
     
-    void operator +=(Closure f) {
-        ComparableClosure closure(std::move(f));
-        while (true) {
-            if (addClosure(closure))
-                break;
-        }
+    /// Subscribe a callable. Small closures are stored inline, larger ones on the heap.
+    template <typename F>
+    void operator +=(F &&f) {
+        addDelegate(makeClosure(std::forward<F>(f)));
     }
     
-    void operator -=(Closure f) {
-        ComparableClosure closure(std::move(f));
-        while (true) {
-            if (removeClosure(closure))
-                break;
-        }
+    /// Unsubscribe the first callable of the same type.
+    template <typename F>
+    void operator -=(F &&f) {
+        removeDelegate(makeClosure(std::forward<F>(f)));
     }
     
     template <typename Ref>
     void Bind(void(Ref::*function)(Args...), Ref *object) {
-        ComparableClosure closure;
-        closure.Callable = [object, function](Args&&...args) {
-            return (object->*function)(std::forward<Args>(args)...);
-        };
-        closure.FunctorSize = sizeof(function);
-        closure.Functor = new uint8_t[closure.FunctorSize];
-        std::memcpy(closure.Functor, (void*)&function, sizeof(function));
-        closure.Object = object;
-        
-        while (true) {
-            if (addClosure(closure))
-                break;
-        }
+        addDelegate(makeDelegate(function, object));
     }
     
     void Bind(void(*function)(Args...)) {
-        ComparableClosure closure;
-        closure.Callable = [function](Args&&...args) {
-            return (*function)(std::forward<Args>(args)...);
-        };
-        closure.FunctorSize = sizeof(function);
-        closure.Functor = new uint8_t[closure.FunctorSize];
-        std::memcpy(closure.Functor, (void*)&function, sizeof(function));
-        
-        while (true) {
-            if (addClosure(closure))
-                break;
-        }
+        addDelegate(makeDelegate(function));
     }
     
     template <typename Ref>
     void Unbind(void(Ref::*function)(Args...), Ref *object) {
-        ComparableClosure closure;
-        closure.FunctorSize = sizeof(function);
-        closure.Functor = new uint8_t[closure.FunctorSize];
-        std::memcpy(closure.Functor, (void*)&function, sizeof(function));
-        closure.Object = object;
-        
-        while (true) {
-            if (removeClosure(closure))
-                break;
-        }
+        removeDelegate(makeDelegate(function, object));
     }
     
     void Unbind(void(*function)(Args...)) {
-        ComparableClosure closure;
-        closure.FunctorSize = sizeof(function);
-        closure.Functor = new uint8_t[closure.FunctorSize];
-        std::memcpy(closure.Functor, (void*)&function, sizeof(function));
-        
-        while (true) {
-            if (removeClosure(closure))
-                break;
-        }
+        removeDelegate(makeDelegate(function));
     }
     
-    void operator()() {
-        auto events = std::atomic_load(&m_events);
-        if (events == nullptr)
+    void operator()(Args&&... arg) {
+        // no subscribers, without touching the reader count
+        if (m_events.load(std::memory_order_relaxed) == nullptr)
             return;
         
-        auto count = events->Count;
-        auto closures = events->Closures;
-        for (int i = 0; i < count; i++)
-            closures[i].Callable();
-    }
-    
-    void operator()(Args&&... arg) {
-        auto events = std::atomic_load(&m_events);
+        ReadGuard guard(m_readers);
+        auto events = m_events.load();
         if (events == nullptr)
             return;
         
-        auto count = events->Count;
-        auto closures = events->Closures;
-        for (int i = 0; i < count; i++)
-            closures[i].Callable(arg...);
+        auto delegates = events->Delegates;
+        if (events->Count == 1) {
+            delegates[0].Invoke(delegates[0], arg...);
+            return;
+        }
+        for (size_t i = 0; i < events->Count; i++)
+            delegates[i].Invoke(delegates[i], arg...);
     }
     
 };
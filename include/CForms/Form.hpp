@@ -6,25 +6,95 @@
 #include "Drawable.hpp"
 #include "Control.hpp"
 #include "TimeProfile.hpp"
+#include "Atlas.hpp"
+#include "Compositor.hpp"
+#include "SpatialIndex.hpp"
+#include "DamageRegion.hpp"
+#include "ThreadPool.hpp"
+#include "UpdateBatch.hpp"
+#include "TripleBuffer.hpp"
+#include "Timestep.hpp"
+#include "Profiler.hpp"
+#include "TraceRecorder.hpp"
+#include "Predicate.hpp"
+#include "Scheduler.hpp"
+#include "ResourceCache.hpp"
+#include "TransformStore.hpp"
+#include "Animator.hpp"
+#include "InputRouter.hpp"
 
 #include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
 #include <X11/Xlib.h>
 #include <X11/extensions/Xrandr.h>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
 
 namespace cf {
 
+class Application;
+
 /// Base type for a SFML window form, with child objects.
 class Form : public ObjectOwner {
 
 private:
     
+    friend class Application;
+    
     Collection<Updatable> m_updatables;
     Collection<Drawable> m_drawables;
+    std::vector<Updatable*> m_removedupdatables;
+    std::vector<Drawable*> m_removeddrawables;
     sf::Clock m_clock;
     TimeProfile m_time;
     sf::Event m_window_event;
+    std::shared_ptr<Atlas> m_atlas;
+    Compositor m_compositor;
+    SpatialIndex<Drawable> m_index;
+    std::vector<Drawable*> m_query;
+    std::vector<Drawable*> m_visible;
+    size_t m_culled;
+    DamageRegion m_damage;
+    sf::RenderTexture m_backbuffer;
+    sf::FloatRect m_clip;
+    std::shared_ptr<ThreadPool> m_pool;
+    UpdateBatch m_batch;
+    std::mutex m_mutex;
+    TripleBuffer<sf::RenderTexture> m_frames;
+    std::thread m_renderer;
+    std::atomic<bool> m_rendering;
+    std::mutex m_framemutex;
+    std::condition_variable m_framepublished;
+    std::shared_ptr<Timestep> m_timestep;
+    std::shared_ptr<Scheduler> m_scheduler;
+    std::shared_ptr<Animator> m_animator;
+    std::shared_ptr<InputRouter> m_input;
+    std::shared_ptr<Profiler> m_profiler;
+    std::shared_ptr<TraceRecorder> m_trace;
+    std::shared_ptr<ResourceCache> m_resources;
+    std::shared_ptr<TransformStore> m_transforms;
+    std::vector<Drawable*> m_storeitems;
+    sf::RenderTexture m_offscreen;
+    sf::Time m_print;
+    sf::Time m_slept;
+    sf::Time m_skipstart;
+    bool m_skipping;
+    Display* m_display;
+    bool m_pumped;
+    bool m_running;
+    std::atomic<bool> m_closing;
+    uint64_t m_frame;
+    uint64_t m_framebudget;
+    uint32_t m_layoutdepth;
+    bool m_layoutresized;
+    Predicate<Form>::Ptr m_until;
     
 protected:
     
@@ -58,6 +128,44 @@ protected:
     /// Form statistics plotting. If true, statistics about the form will be printed to the console.
     bool m_plotstats;
     
+    /// Atlas mode. If true, drawable objects share packed render textures of the form, instead of owning one each.
+    /// Must be set before objects are created, e.g. in the constructor.
+    bool m_useatlas;
+    
+    /// Partial redraw mode. If true, only areas of the window which changed are redrawn, inside a back buffer.
+    /// Draw() has to draw through Canvas() and Clear() in this mode. Must be set before the form is opened.
+    bool m_partialredraw;
+    
+    /// Parallel update mode. If not 0, thread-safe objects and dependency groups are updated on a pool of this ammount of worker threads.
+    /// See m_threadsafe and m_updategroup of cf::Updatable. Must be set before objects are created, e.g. in the constructor.
+    uint32_t m_updatethreads;
+    
+    /// Render thread mode. If true, frames are composited off-screen and presented in the window by a dedicated thread.
+    /// The frame limit and vsync then only stall the render thread, while the update loop paces itself to m_framelimit.
+    /// Draw() has to draw through Canvas() and Clear() in this mode. Must be set before the form is opened.
+    /// SFML graphics objects must not be created before the first form or cf::Application, which initialize Xlib for several threads.
+    bool m_renderthread;
+    
+    /// Fixed timestep mode. If not zero, the form and its objects are updated with exactly this duration, as often as the elapsed time allows.
+    /// Update sequences then do not depend on the frame rate. Draw() can interpolate between steps with Alpha().
+    sf::Time m_fixedstep;
+    
+    /// Maximum ammount of fixed update steps per frame. Time beyond it is dropped, instead of catching up.
+    uint32_t m_maxsteps;
+    
+    /// Headless mode. If true, the form is drawn into an off-screen render texture instead of a window, e.g. for batch rendering or tests.
+    /// There are no window events, the frame limit is ignored and the render thread mode is not available.
+    /// SFML still needs a display server for its OpenGL context, e.g. Xvfb on machines without a screen. Must be set before the form is opened.
+    bool m_headless;
+    
+    /// Idle mode. If true, the form sleeps until the next window event while nothing is dirty, no frame was requested and no timer is due.
+    /// Animating objects then have to call RequestFrame() on every update, and periodic work should use SetTimer(). Ignored in headless mode.
+    bool m_idle;
+    
+    /// Transform store mode. If true, the transforms of the form's drawable objects are kept in a cf::TransformStore,
+    /// so Transforms() can move all of them in bulk, with one change notification per frame. Must be set before objects are created, e.g. in the constructor.
+    bool m_transformstore;
+    
 public:
     
     /// Fired when the form was opened.
@@ -83,6 +191,11 @@ public:
     /// @param color New background color.
     Event<Form*, const sf::Color&> BackgroundChanged;
     
+    /// Fired at the end of every frame, after the form was drawn and displayed. Use SaveFrame() here to dump frames.
+    /// @param sender Form which fired the event.
+    /// @param frame Number of the frame, starting at 0 when the form was opened.
+    Event<Form*, const uint64_t&> FrameEnded;
+    
 protected:
     
     /// Override this to handle SFML window events.
@@ -94,133 +207,682 @@ protected:
     
     /// Override this to draw your form
     virtual void Draw() {
-        m_window.clear(m_background);
+        Clear(m_background);
+    }
+    
+    /// Clear the form's canvas with the given color.
+    /// In partial redraw mode, only the area which is currently redrawn is cleared.
+    void Clear(const sf::Color& color) {
+        if (m_clip.width <= 0.0f || m_clip.height <= 0.0f) {
+            Canvas()->clear(color);
+            return;
+        }
+        sf::RectangleShape shape(sf::Vector2f(m_clip.width, m_clip.height));
+        shape.setPosition(sf::Vector2f(m_clip.left, m_clip.top));
+        shape.setFillColor(color);
+        Canvas()->draw(shape, sf::RenderStates(sf::BlendNone));
     }
     
 private:
     
     /// Internal operating loop of the form.
     void __Loop() {
-        Opened(this);
-        if (m_plotstats) std::cout << "Time Profile '" + m_name + "':\n\n\n\n\n\n\n";
-        sf::Time print;
-        m_clock.restart();
-        while (m_window.isOpen()) {
-            m_time.cycle = m_clock.restart();
-            if (m_plotstats) {
-                print += m_time.cycle;
-                if (print.asSeconds() > 1.0f / 4.0f) {
-                    std::cout << "\e[6F\e[0J" << m_time.ToString() << "\n";
-                    std::cout << "Objects: " << ObjectCount() << ", Updatables: " << m_updatables.Count() << ", Drawables: " << m_drawables.Count() << "\n";
-                    print = {};
+        while (__IsOpen()) {
+            if (m_idle && !m_headless) {
+                TraceRecorder::Scope scope(m_trace.get(), "form", "Idle");
+                sf::Time start = m_clock.getElapsedTime();
+                __WaitIdle();
+                m_slept += m_clock.getElapsedTime() - start;
+                if (!__IsOpen()) break;
+            }
+            __Frame();
+        }
+        __Finish();
+    }
+    
+    /// Internal call to run a single frame of the form.
+    void __Frame() {
+        TraceRecorder::Scope frame(m_trace.get(), "form", "Frame");
+        // sleeping in idle mode does not count, so updates and animations continue where they stopped
+        m_time.cycle = m_clock.restart() - m_slept;
+        m_slept = sf::Time::Zero;
+        m_scheduler->BeginFrame();
+        if (m_plotstats) {
+            m_print += m_time.cycle;
+            if (m_print.asSeconds() > 1.0f / 4.0f) {
+                std::cout << "\e[6F\e[0J" << m_time.ToString() << "\n";
+                std::cout << "Objects: " << ObjectCount() << ", Updatables: " << m_updatables.Count() << ", Awake: " << m_batch.AwakeCount() << ", Drawables: " << m_drawables.Count();
+                std::cout << ", Culled: " << m_culled << ", Draw calls: " << m_compositor.DrawCalls();
+                if (m_atlas) std::cout << ", Atlas pages: " << m_atlas->PageCount();
+                std::cout << "\n";
+                m_print = {};
+            }
+        }
+        m_time.window_events = m_clock.getElapsedTime();
+        {
+            TraceRecorder::Scope scope(m_trace.get(), "form", "Window events");
+            while (!m_headless && m_window.pollEvent(m_window_event)) {
+                __HandleWindowEvent(m_window_event);
+            }
+            m_input->__Flush(this);
+        }
+        m_time.window_events = m_clock.getElapsedTime() - m_time.window_events;
+        
+        m_timestep->SetStep(m_fixedstep, m_maxsteps);
+        uint32_t steps = m_timestep->Advance(m_time.cycle);
+        sf::Time delta = m_timestep->Delta(m_time.cycle);
+        m_time.form_update = sf::Time::Zero;
+        m_time.object_updates = sf::Time::Zero;
+        for (uint32_t step = 0; step < steps; ++step) {
+            m_scheduler->AdvanceUpdate(delta);
+            sf::Time start = m_clock.getElapsedTime();
+            {
+                TraceRecorder::Scope scope(m_trace.get(), "form", "Form update");
+                Update(delta);
+            }
+            sf::Time updated = m_clock.getElapsedTime();
+            {
+                TraceRecorder::Scope scope(m_trace.get(), "form", "Object updates");
+                m_batch.Run(delta, m_pool.get(), m_profiler.get());
+                __FlushPending();
+            }
+            m_time.form_update += updated - start;
+            m_time.object_updates += m_clock.getElapsedTime() - updated;
+        }
+        if (m_animator->ActiveCount() != 0U) {
+            TraceRecorder::Scope scope(m_trace.get(), "form", "Animations");
+            m_animator->__Run(m_time.cycle);
+            // idle forms keep running while anything is animated
+            if (m_animator->ActiveCount() != 0U) m_scheduler->RequestFrame();
+        }
+        if (m_transforms) m_transforms->Flush();
+        
+        m_time.object_draws = m_clock.getElapsedTime();
+        {
+            TraceRecorder::Scope scope(m_trace.get(), "form", "Object draws");
+            m_index.Query(sf::FloatRect(0.0f, 0.0f, float(m_size.x), float(m_size.y)), m_visible);
+            m_culled = m_drawables.Count() - m_visible.size();
+            for (auto& drawable : m_visible) {
+                if (drawable->Error() != 0U) continue;
+                if (drawable->IsDirty()) {
+                    m_dirty = true;
+                    if (m_partialredraw) m_damage.Add(drawable->Bounds());
                 }
+                Profiler::Scope scope(m_profiler.get(), drawable, Profiler::DrawTotal);
+                drawable->__DrawCall();
             }
-            m_time.window_events = m_clock.getElapsedTime();
-            while (m_window.pollEvent(m_window_event)) {
-                if (m_window_event.type == sf::Event::Closed) {
-                    m_window.close();
+        }
+        m_time.object_draws = m_clock.getElapsedTime() - m_time.object_draws;
+        
+        m_time.form_draw = m_clock.getElapsedTime();
+        if (m_dirty) {
+            {
+                TraceRecorder::Scope scope(m_trace.get(), "form", "Composite");
+                if (m_partialredraw) {
+                    __DrawDamage();
                 }
                 else {
-                    WindowEvent(m_window_event);
+                    Draw();
+                    for (auto& drawable : m_visible) {
+                        if (drawable->Error() != 0U) continue;
+                        m_compositor.Add(drawable->Canvas()->getTexture(), drawable->TextureRect(), drawable->Transform()->Position());
+                    }
+                    m_compositor.Draw(*Canvas());
                 }
             }
-            m_time.window_events = m_clock.getElapsedTime() - m_time.window_events;
-            
-            m_time.form_update = m_clock.getElapsedTime();
-            Update(m_time.cycle);
-            m_time.form_update = m_clock.getElapsedTime() - m_time.form_update;
-            
-            m_time.object_updates = m_clock.getElapsedTime();
-            for (auto& updatable : m_updatables) {
-                if (updatable->Error() != 0U) continue;
-                updatable->__UpdateCall(m_time.cycle);
+            {
+                TraceRecorder::Scope scope(m_trace.get(), "form", "Display");
+                if (m_renderthread) __PublishFrame();
+                else if (m_headless) m_offscreen.display();
+                else m_window.display();
             }
-            m_time.object_updates = m_clock.getElapsedTime() - m_time.object_updates;
-            
-            m_time.object_draws = m_clock.getElapsedTime();
-            for (auto& drawable : m_drawables) {
-                if (drawable->Error() != 0U) continue;
-                if (drawable->IsDirty()) m_dirty = true;
-                drawable->__DrawCall();
+            m_dirty = false;
+        }
+        m_time.form_draw = m_clock.getElapsedTime() - m_time.form_draw;
+        m_profiler->EndFrame();
+        m_trace->EndFrame();
+        
+        FrameEnded(this, m_frame);
+        m_frame++;
+        if (m_framebudget != 0U && m_frame >= m_framebudget) m_closing = true;
+        if (m_until && m_until(this)) m_closing = true;
+        if (m_closing) __Stop();
+        
+        // pumped forms are paced by their application
+        if (m_renderthread && m_framelimit != 0U && !m_pumped) {
+            sf::Time period = sf::seconds(1.0f / float(m_framelimit));
+            sf::Time elapsed = m_clock.getElapsedTime();
+            if (elapsed < period) sf::sleep(period - elapsed);
+        }
+    }
+    
+    /// Internal call to make Xlib safe for several threads, e.g. the render thread or the forms of a threaded cf::Application.
+    /// XInitThreads() has to be the first Xlib call of the process, so this runs in the constructor, before any window or render texture exists.
+    static void __InitThreads() {
+        static const bool initialized = XInitThreads() != 0;
+        (void)initialized;
+    }
+    
+    /// Internal call to create the window or off-screen canvas of the form, before its first frame.
+    bool __Start() {
+        if (!__InitCall()) {
+            std::cout << "[X] Form: Failed to initialize '" + m_name + "'\n";
+            return false;
+        }
+        if (m_headless) {
+            if (m_renderthread) {
+                std::cerr << "[X] '" + m_name + "': Render thread is not available in headless mode.\n";
+                m_renderthread = false;
             }
-            m_time.object_draws = m_clock.getElapsedTime() - m_time.object_draws;
-            
-            m_time.form_draw = m_clock.getElapsedTime();
-            if (m_dirty) {
-                Draw();
-                for (auto& drawable : m_drawables) {
-                    if (drawable->Error() != 0U) continue;
-                    sf::Sprite sprite(drawable->Canvas()->getTexture());
-                    sprite.setPosition(sf::Vector2f(drawable->Transform()->Position()));
-                    m_window.draw(sprite);
-                }
-                m_window.display();
-                m_dirty = false;
+            if (!m_offscreen.create(m_size.x, m_size.y, m_contextsettings)) {
+                std::cerr << "[X] '" + m_name + "': Failed to create off-screen canvas.\n";
+                return false;
             }
-            m_time.form_draw = m_clock.getElapsedTime() - m_time.form_draw;
+            m_running = true;
         }
+        else {
+            m_window.create({m_size.x, m_size.y}, m_title, m_style, m_contextsettings);
+            m_window.setFramerateLimit(m_pumped ? 0U : m_framelimit);
+            __CenterWindow();
+        }
+        if (m_partialredraw && !m_backbuffer.create(m_size.x, m_size.y)) {
+            std::cerr << "[X] '" + m_name + "': Failed to create back buffer. Partial redraw is disabled.\n";
+            m_partialredraw = false;
+        }
+        __DamageAll();
+        if (m_renderthread && !__StartRenderThread()) m_renderthread = false;
+        m_frame = 0U;
+        m_closing = false;
+        m_print = sf::Time::Zero;
+        m_slept = sf::Time::Zero;
+        m_skipping = false;
+        Opened(this);
+        if (m_plotstats) std::cout << "Time Profile '" + m_name + "':\n\n\n\n\n\n\n";
+        m_clock.restart();
+        return true;
+    }
+    
+    /// Internal call to clean up after the last frame of the form.
+    void __Finish() {
+        __StopRenderThread();
+        m_trace->Close();
+        __SyncProfiler();
         Closed(this);
     }
     
+    /// Internal call to keep the profiler records of the form's objects only while they are used, by profiling or tracing single objects.
+    void __SyncProfiler() {
+        if (m_profiler->IsActive()) m_profiler->RegisterAll(this);
+        else m_profiler->Clear();
+    }
+    
+    /// Internal call of cf::Application to check if an idle form can skip its next frame.
+    bool __CanSkipFrame() {
+        bool skip = __IsIdle();
+        // skipped frames count as sleeping, from the first one until the form wakes up
+        if (skip && !m_skipping) m_skipstart = m_clock.getElapsedTime();
+        if (!skip && m_skipping) m_slept += m_clock.getElapsedTime() - m_skipstart;
+        m_skipping = skip;
+        return skip;
+    }
+    
+    /// Internal call to check if an idle form has nothing to do. Handles the first pending window event, which always needs a frame.
+    bool __IsIdle() {
+        if (!m_idle || m_headless) return false;
+        if (m_dirty || m_closing || m_scheduler->IsFrameRequested()) return false;
+        sf::Time wait;
+        if (m_scheduler->NextTimer(wait) && wait <= sf::Time::Zero) return false;
+        if (m_window.pollEvent(m_window_event)) {
+            __HandleWindowEvent(m_window_event);
+            return false;
+        }
+        return true;
+    }
+    
+    /// Internal call to handle a single SFML window event.
+    void __HandleWindowEvent(sf::Event& window_event) {
+        if (window_event.type == sf::Event::Closed) {
+            __StopRenderThread();
+            m_window.close();
+        }
+        else {
+            WindowEvent(window_event);
+            m_input->__Handle(this, window_event);
+        }
+    }
+    
+    /// Internal call to sleep in idle mode, until a window event arrives, a timer is due or a frame was requested.
+    void __WaitIdle() {
+        // SFML can not wait for window events with a timeout, so pending timers are awaited in frame sized sleeps
+        sf::Time period = sf::seconds(1.0f / float(m_framelimit != 0U ? m_framelimit : 60U));
+        while (m_window.isOpen() && !m_dirty && !m_closing && !m_scheduler->IsFrameRequested()) {
+            sf::Time wait;
+            if (!m_scheduler->NextTimer(wait)) {
+                if (m_window.waitEvent(m_window_event)) __HandleWindowEvent(m_window_event);
+                return;
+            }
+            if (wait <= sf::Time::Zero) return;
+            sf::sleep(std::min(wait, period));
+            if (m_window.pollEvent(m_window_event)) {
+                __HandleWindowEvent(m_window_event);
+                return;
+            }
+        }
+    }
+    
+    /// Internal call to check if the window or the headless canvas of the form is open.
+    bool __IsOpen() const {
+        return m_headless ? m_running : m_window.isOpen();
+    }
+    
+    /// Internal call to close the window or the headless canvas of the form.
+    void __Stop() {
+        m_closing = false;
+        if (m_headless) {
+            m_running = false;
+            return;
+        }
+        __StopRenderThread();
+        m_window.close();
+    }
+    
+    /// Internal call to center the window on the first screen. Skipped if the screen can not be queried.
+    void __CenterWindow() {
+        Display* display = m_display ? m_display : XOpenDisplay(nullptr);
+        if (!display) return;
+        XRRScreenResources* screens = XRRGetScreenResources(display, DefaultRootWindow(display));
+        if (screens && screens->ncrtc > 0) {
+            XRRCrtcInfo* info = XRRGetCrtcInfo(display, screens, screens->crtcs[0]);
+            if (info) {
+                m_window.setPosition(sf::Vector2i((int(info->width) / 2) - int(m_size.x / 2), (int(info->height) / 2) - int(m_size.y / 2)));
+                XRRFreeCrtcInfo(info);
+            }
+        }
+        if (screens) XRRFreeScreenResources(screens);
+        if (display != m_display) XCloseDisplay(display);
+    }
+    
+    /// Internal call to redraw the damaged areas of the form into the back buffer, and present it in the window or frame buffer.
+    void __DrawDamage() {
+        sf::FloatRect window(0.0f, 0.0f, float(m_size.x), float(m_size.y));
+        for (const auto& rect : m_damage.Rects()) {
+            if (!rect.intersects(window, m_clip)) continue;
+            sf::View view(m_clip);
+            view.setViewport(sf::FloatRect(m_clip.left / window.width, m_clip.top / window.height, m_clip.width / window.width, m_clip.height / window.height));
+            m_backbuffer.setView(view);
+            Draw();
+            m_index.Query(m_clip, m_query);
+            for (auto& drawable : m_query) {
+                if (drawable->Error() != 0U) continue;
+                m_compositor.Add(drawable->Canvas()->getTexture(), drawable->TextureRect(), drawable->Transform()->Position());
+            }
+            m_compositor.Draw(m_backbuffer);
+        }
+        m_clip = sf::FloatRect();
+        m_damage.Clear();
+        m_backbuffer.setView(m_backbuffer.getDefaultView());
+        m_backbuffer.display();
+        sf::RenderTarget* target = &m_window;
+        if (m_renderthread) target = &m_frames.Back();
+        else if (m_headless) target = &m_offscreen;
+        target->draw(sf::Sprite(m_backbuffer.getTexture()), sf::RenderStates(sf::BlendNone));
+    }
+    
+    /// Internal call to create the frame buffers and start the render thread.
+    bool __StartRenderThread() {
+        for (uint8_t i = 0; i < 3U; ++i) {
+            if (!m_frames.Slot(i).create(m_size.x, m_size.y)) {
+                std::cerr << "[X] '" + m_name + "': Failed to create frame buffers. Render thread is disabled.\n";
+                return false;
+            }
+        }
+        m_window.setActive(false);
+        m_rendering = true;
+        m_renderer = std::thread(&Form::__Render, this);
+        return true;
+    }
+    
+    /// Internal call to stop the render thread, after it finished presenting the current frame.
+    void __StopRenderThread() {
+        if (!m_renderer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(m_framemutex);
+            m_rendering = false;
+        }
+        m_framepublished.notify_one();
+        m_renderer.join();
+    }
+    
+    /// Internal operating loop of the render thread. Presents the latest published frame, and skips older ones.
+    void __Render() {
+        m_window.setActive(true);
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_framemutex);
+                m_framepublished.wait(lock, [this]() { return !m_rendering || m_frames.HasFresh(); });
+                if (!m_rendering) break;
+            }
+            m_frames.Acquire();
+            m_window.draw(sf::Sprite(m_frames.Front().getTexture()), sf::RenderStates(sf::BlendNone));
+            m_window.display();
+        }
+        m_window.setActive(false);
+    }
+    
+    /// Internal call to hand the composited frame over to the render thread.
+    void __PublishFrame() {
+        m_frames.Back().display();
+        // display() does not flush, and the render thread samples the frame from its own context
+        glFlush();
+        {
+            std::lock_guard<std::mutex> lock(m_framemutex);
+            m_frames.Publish();
+        }
+        m_framepublished.notify_one();
+    }
+    
+    /// Internal call to recreate the canvases of the form for its current size, and report it.
+    void __ApplySize() {
+        if (m_window.isOpen()) m_window.setSize(m_size);
+        if (m_headless && m_running && !m_offscreen.create(m_size.x, m_size.y, m_contextsettings)) {
+            std::cerr << "[X] '" + m_name + "': Failed to recreate off-screen canvas.\n";
+            m_running = false;
+        }
+        if (m_partialredraw && __IsOpen() && !m_backbuffer.create(m_size.x, m_size.y)) {
+            std::cerr << "[X] '" + m_name + "': Failed to recreate back buffer. Partial redraw is disabled.\n";
+            m_partialredraw = false;
+        }
+        if (m_renderer.joinable()) {
+            __StopRenderThread();
+            if (!__StartRenderThread()) m_renderthread = false;
+        }
+        __DamageAll();
+        m_dirty = true;
+        SizeChanged(this, m_size);
+    }
+    
+    /// Internal call to mark the whole form as damaged.
+    void __DamageAll() {
+        m_damage.Add(sf::FloatRect(0.0f, 0.0f, float(m_size.x), float(m_size.y)));
+    }
+    
     /// Internal handler call to manage position changes of drawable child objects.
     void __OnObjectPositionChanged(Drawable*, const sf::Vector2f& position) {
+        std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+        if (m_pool) lock.lock();
+        m_dirty = true;
+    }
+    
+    /// Internal handler call to index moved or resized drawable child objects, and collect their damaged areas.
+    void __OnObjectBoundsChanged(Drawable* drawable, const sf::FloatRect& previous, const sf::FloatRect& bounds) {
+        std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+        if (m_pool) lock.lock();
+        m_index.Update(drawable, bounds);
+        if (!m_partialredraw) return;
+        m_damage.Add(previous);
+        m_damage.Add(bounds);
         m_dirty = true;
     }
     
+    /// Internal handler call to index and damage drawable child objects which were moved in bulk through the transform store.
+    void __OnTransformsChanged(TransformStore* store) {
+        size_t slots = std::min(store->SlotCount(), m_storeitems.size());
+        for (uint32_t slot = 0; slot < slots; ++slot) {
+            Drawable* drawable = m_storeitems[slot];
+            if (!drawable || !store->IsChanged(slot)) continue;
+            sf::FloatRect previous = drawable->__SyncBounds();
+            sf::FloatRect bounds = drawable->Bounds();
+            m_index.Update(drawable, bounds);
+            if (!m_partialredraw) continue;
+            m_damage.Add(previous);
+            m_damage.Add(bounds);
+        }
+        m_dirty = true;
+    }
+    
+    /// Internal handler call to compact the collections after a batch of deferred deletions.
+    void __OnPendingFlushed(ObjectOwner* sender) {
+        m_updatables.RemoveAll(std::move(m_removedupdatables));
+        m_drawables.RemoveAll(std::move(m_removeddrawables));
+        m_removedupdatables.clear();
+        m_removeddrawables.clear();
+    }
+    
     /// Internal handler call to manage created updatable and drawable objects.
     void __OnObjectCreated(ObjectOwner* sender, Object*& object) {
+        if (m_updatethreads != 0U && !m_pool) m_pool = std::make_shared<ThreadPool>(m_updatethreads);
+        m_profiler->Register(object);
         if (ObjectOwner* owner = dynamic_cast<ObjectOwner*>(object)) {
             Register<ObjectOwner>(owner);
         }
         if (Control* control = dynamic_cast<Control*>(object)) {
             Register<Control>(control);
+            if (m_pool) control->__SetPool(m_pool);
+            control->__SetProfiler(m_profiler);
+            control->__SetInput(m_input);
         }
         if (Updatable* updatable = dynamic_cast<Updatable*>(object)) {
             Register<Updatable>(updatable);
             m_updatables.Add(updatable);
+            m_batch.Add(updatable);
+            updatable->__SetScheduler(m_scheduler);
+            updatable->__SetAnimator(m_animator);
         }
         if (Drawable* drawable = dynamic_cast<Drawable*>(object)) {
             Register<Drawable>(drawable);
             m_drawables.Add(drawable);
             drawable->PositionChanged.Bind(&Form::__OnObjectPositionChanged, this);
+            drawable->BoundsChanged.Bind(&Form::__OnObjectBoundsChanged, this);
+            drawable->__SetTimestep(m_timestep);
+            if (m_transformstore) {
+                if (!m_transforms) {
+                    m_transforms = std::make_shared<TransformStore>();
+                    m_transforms->Changed.Bind(&Form::__OnTransformsChanged, this);
+                }
+                drawable->Transform()->__Attach(m_transforms.get());
+                uint32_t slot = drawable->Transform()->Slot();
+                if (slot >= m_storeitems.size()) m_storeitems.resize(slot + 1U, nullptr);
+                m_storeitems[slot] = drawable;
+            }
+            m_index.Insert(drawable, drawable->Bounds());
+            if (m_useatlas) {
+                if (!m_atlas) m_atlas = std::make_shared<Atlas>();
+                drawable->__SetAtlas(m_atlas, 0U);
+            }
+            // objects created inside a transaction join it
+            if (m_layoutdepth != 0U) drawable->SuspendLayout();
         }
     }
     
     /// Internal handler call to manage deleted updatable and drawable objects.
     void __OnObjectDeleted(ObjectOwner* sender, Object*& object) {
+        m_profiler->Unregister(object);
         if (cf::Updatable* updatable = dynamic_cast<cf::Updatable*>(object)) {
-            m_updatables.Remove(updatable);
+            if (IsFlushing()) m_removedupdatables.push_back(updatable);
+            else m_updatables.Remove(updatable);
+            m_batch.Remove(updatable);
         }
         if (cf::Drawable* drawable = dynamic_cast<cf::Drawable*>(object)) {
-            m_drawables.Remove(drawable);
+            if (IsFlushing()) m_removeddrawables.push_back(drawable);
+            else m_drawables.Remove(drawable);
             drawable->PositionChanged.Unbind(&Form::__OnObjectPositionChanged, this);
+            drawable->BoundsChanged.Unbind(&Form::__OnObjectBoundsChanged, this);
+            if (m_transforms && drawable->Transform()->Store() == m_transforms.get()) {
+                m_storeitems[drawable->Transform()->Slot()] = nullptr;
+                drawable->Transform()->__Detach();
+            }
+            m_index.Remove(drawable);
+            if (m_partialredraw) {
+                m_damage.Add(drawable->Bounds());
+                m_dirty = true;
+            }
         }
     }
     
 public:
     
     /// Opens the SFML window of the form.
+    /// Blocks until the form is closed. Use cf::Application to run several forms in one process.
     virtual void Open() {
-        if (!__InitCall()) {
-            std::cout << "[X] Form: Failed to initialize '" + m_name + "'\n";
-            return;
-        }
-        m_window.create({m_size.x, m_size.y}, m_title, m_style, m_contextsettings);
-        m_window.setFramerateLimit(m_framelimit);
-        Display* display = XOpenDisplay(nullptr);
-        XRRScreenResources *screens = XRRGetScreenResources(display, DefaultRootWindow(display));
-        XRRCrtcInfo *info = XRRGetCrtcInfo(display, screens, screens->crtcs[0]);
-        m_window.setPosition(sf::Vector2i((info->width / 2) - (m_size.x / 2), (info->height / 2) - (m_size.y / 2)));
-        XRRFreeCrtcInfo(info);
-        XRRFreeScreenResources(screens);
+        if (!__Start()) return;
         __Loop();
     }
     
+    /// Opens the form for the given ammount of frames, then closes it again.
+    virtual void Run(uint64_t frames) {
+        m_framebudget = std::max<uint64_t>(frames, 1U);
+        Open();
+        m_framebudget = 0U;
+    }
+    
+    /// Opens the form until the predicate holds at the end of a frame, then closes it again.
+    /// @param maxframes Maximum ammount of frames. 0 for no limit.
+    virtual void RunUntil(Predicate<Form>::Ptr p, uint64_t maxframes = 0U) {
+        m_until = p;
+        m_framebudget = maxframes;
+        Open();
+        m_until = nullptr;
+        m_framebudget = 0U;
+    }
+    
+    /// Request one more frame of the form, e.g. while animating in idle mode.
+    void RequestFrame() {
+        m_scheduler->RequestFrame();
+    }
+    
+    /// Call a function once after a delay, or repeatedly in an interval, on the form's thread before its update.
+    /// Cancel the timer through CancelTimer() before anything the function refers to is destroyed.
+    /// @return ID of the timer.
+    uint64_t SetTimer(const sf::Time& delay, Scheduler::Callback callback, bool repeat = false) {
+        return m_scheduler->SetTimer(delay, std::move(callback), repeat);
+    }
+    
+    /// Cancel a timer started through SetTimer().
+    bool CancelTimer(uint64_t id) {
+        return m_scheduler->CancelTimer(id);
+    }
+    
+    /// Closes the form at the end of the current frame.
+    virtual void Close() {
+        if (__IsOpen()) m_closing = true;
+    }
+    
+    /// Copy of the latest frame of the form.
+    /// Only available for headless forms and in partial redraw mode, which keep the frame in an off-screen buffer. Otherwise, the image is empty.
+    sf::Image CaptureFrame() const {
+        if (m_headless && !m_partialredraw) return m_offscreen.getTexture().copyToImage();
+        if (m_partialredraw) return m_backbuffer.getTexture().copyToImage();
+        std::cerr << "[X] '" + m_name + "': Failed to capture frame. Only headless forms and partial redraw keep the frame.\n";
+        return sf::Image();
+    }
+    
+    /// Save the latest frame of the form to an image file, see CaptureFrame().
+    bool SaveFrame(const std::string& path) const {
+        sf::Image image = CaptureFrame();
+        if (image.getSize().x == 0U) return false;
+        if (!image.saveToFile(path)) {
+            std::cerr << "[X] '" + m_name + "': Failed to save frame to '" + path + "'.\n";
+            return false;
+        }
+        return true;
+    }
+    
+    /// Router of the form's mouse and keyboard input to its controls, with the hovered, focused and captured control.
+    InputRouter* Input() {
+        return m_input.get();
+    }
+    
+    /// Tweens of the form, to animate positions, sizes and background colors of its objects without per-object update code.
+    Animator* Animations() {
+        return m_animator.get();
+    }
+    
+    /// Structure of arrays with the transforms of the form's drawable objects, to move them in bulk, e.g. in Update().
+    /// Bulk moves do not fire PositionChanged or BoundsChanged of the objects. Null unless m_transformstore is set.
+    TransformStore* Transforms() {
+        return m_transforms.get();
+    }
+    
+    /// Cache of textures and fonts for the form. Shared by all forms of the same cf::Application.
+    ResourceCache* Resources() {
+        if (!m_resources) m_resources = std::make_shared<ResourceCache>();
+        return m_resources.get();
+    }
+    
+    /// Number of the current frame, starting at 0 when the form was opened.
+    uint64_t FrameCount() const {
+        return m_frame;
+    }
+    
     /// Pointer reference to the SFML window of the form.
     virtual sf::RenderWindow* Window() {
         return &m_window;
     }
     
+    /// Pointer reference to the render target the form is drawn into.
+    /// This is the back buffer in partial redraw mode, the current frame buffer in render thread mode,
+    /// the off-screen canvas in headless mode, otherwise the window.
+    virtual sf::RenderTarget* Canvas() {
+        if (m_partialredraw) return &m_backbuffer;
+        if (m_renderthread) return &m_frames.Back();
+        if (m_headless) return &m_offscreen;
+        return &m_window;
+    }
+    
+    /// All drawable objects intersecting the given window area, in drawing order.
+    std::vector<Drawable*> QueryRegion(const sf::FloatRect& rect) {
+        return m_index.Query(rect);
+    }
+    
+    /// Ammount of drawable objects skipped in the previous cycle, because they were outside of the window.
+    size_t CulledCount() const {
+        return m_culled;
+    }
+    
+    /// Topmost drawable object at the given window position. Null if there is none.
+    Drawable* HitTest(const sf::Vector2f& point) {
+        return m_index.QueryTopmost(point, [](Drawable* drawable) { return drawable->Error() == 0U; });
+    }
+    
+    /// Progress from the previous towards the next fixed update step, between 0 and 1, to interpolate drawing.
+    /// Always 1 without a fixed timestep.
+    float Alpha() const {
+        return m_timestep->Alpha();
+    }
+    
+    /// Update, draw and composite timings of the form's objects over the recent frames, most expensive objects first.
+    /// Empty until profiling was turned on through SetProfiling().
+    /// @param count Maximum ammount of objects.
+    std::vector<ProfileEntry> Profile(size_t count = SIZE_MAX) const {
+        return m_profiler->Query(count);
+    }
+    
+    /// Start streaming the form's frame timelines into a Chrome Trace Event JSON file, to be opened in chrome://tracing or Perfetto.
+    /// A previous trace is finished first. The trace is finished when the form is closed.
+    /// @param objects If true, update and draw timings of single objects are recorded too.
+    bool StartTrace(const std::string& path, bool objects = false) {
+        bool opened = m_trace->Open(path, objects);
+        __SyncProfiler();
+        return opened;
+    }
+    
+    /// Finish the trace started by StartTrace(), and write all remaining events.
+    void StopTrace() {
+        m_trace->Close();
+        __SyncProfiler();
+    }
+    
+    /// True if the timings of the form's objects are recorded.
+    bool IsProfiling() const {
+        return m_profiler->IsEnabled();
+    }
+    
+    /// Turn recording the timings of the form's objects on or off. Can be changed at any time, except from parallel updates.
+    virtual void SetProfiling(bool profiling) {
+        m_profiler->SetEnabled(profiling);
+        __SyncProfiler();
+    }
+    
     /// Current SFML window title of the form. 
     virtual const std::string& Title() const {
         return m_title;
@@ -273,8 +935,11 @@ public:
     virtual void SetSize(const sf::Vector2u& size) {
         if (m_size == size) return;
         m_size = size;
-        if (m_window.isOpen()) m_window.setSize(m_size);
-        SizeChanged(this, m_size);
+        if (m_layoutdepth != 0U) {
+            m_layoutresized = true;
+            return;
+        }
+        __ApplySize();
     }
     
     /// Change the background color of the form.
@@ -282,15 +947,44 @@ public:
         if (m_background == color) return;
         m_background = color;
         m_dirty = true;
+        __DamageAll();
         BackgroundChanged(this, m_background);
     }
     
     /// Mark the form to be redrawn
     virtual void SetDirty(bool dirty = true) {
         m_dirty = dirty;
+        if (dirty) __DamageAll();
+    }
+    
+    /// True while size changes of the form and transform changes of its objects are collected, between SuspendLayout() and ResumeLayout().
+    bool IsLayoutSuspended() const {
+        return m_layoutdepth != 0U;
+    }
+    
+    /// Start collecting size changes of the form and transform changes of all its drawable objects, instead of reporting each one.
+    /// Calls can be nested. Objects created meanwhile join the transaction.
+    virtual void SuspendLayout() {
+        if (m_layoutdepth == 0U) {
+            for (size_t i = 0; i < m_drawables.Count(); ++i) m_drawables[i]->SuspendLayout();
+        }
+        m_layoutdepth++;
+    }
+    
+    /// Finish a SuspendLayout() call. After the outermost one, every changed object reallocates its canvas and reports its changes once,
+    /// then the form recreates its own canvases if it was resized.
+    virtual void ResumeLayout() {
+        if (m_layoutdepth == 0U) return;
+        if (m_layoutdepth == 1U) {
+            for (size_t i = 0; i < m_drawables.Count(); ++i) m_drawables[i]->ResumeLayout();
+        }
+        if (--m_layoutdepth != 0U || !m_layoutresized) return;
+        m_layoutresized = false;
+        __ApplySize();
     }
     
     Form(ObjectOwner* owner, const std::string& name) : Object(owner, name) {
+        __InitThreads();
         m_title = m_name;
         m_size = sf::Vector2u(500U, 400U);
         m_style = 7U;
@@ -307,8 +1001,36 @@ public:
         m_background = sf::Color(0x000000FF);
         m_dirty = true;
         m_plotstats = false;
+        m_useatlas = false;
+        m_partialredraw = false;
+        m_updatethreads = 0U;
+        m_renderthread = false;
+        m_fixedstep = sf::Time::Zero;
+        m_maxsteps = 5U;
+        m_timestep = std::make_shared<Timestep>();
+        m_scheduler = std::make_shared<Scheduler>();
+        m_animator = std::make_shared<Animator>();
+        m_input = std::make_shared<InputRouter>();
+        m_profiler = std::make_shared<Profiler>();
+        m_trace = std::make_shared<TraceRecorder>();
+        m_profiler->SetTrace(m_trace);
+        m_headless = false;
+        m_idle = false;
+        m_transformstore = false;
+        m_rendering = false;
+        m_display = nullptr;
+        m_pumped = false;
+        m_skipping = false;
+        m_running = false;
+        m_closing = false;
+        m_frame = 0U;
+        m_framebudget = 0U;
+        m_layoutdepth = 0U;
+        m_layoutresized = false;
+        m_culled = 0U;
         ObjectCreated.Bind(&cf::Form::__OnObjectCreated, this);
         ObjectDeleted.Bind(&cf::Form::__OnObjectDeleted, this);
+        PendingFlushed.Bind(&cf::Form::__OnPendingFlushed, this);
     }
     
     Form(const std::string& name) : Form(nullptr, name) {}
@@ -316,8 +1038,15 @@ public:
     Form() : Form(nullptr, "Form") {}
     
     virtual ~Form() {
+        __StopRenderThread();
+        // objects are destroyed after the store, so their transforms take their values back first
+        for (Drawable* drawable : m_storeitems) {
+            if (drawable) drawable->Transform()->__Detach();
+        }
+        if (m_transforms) m_transforms->Changed.Unbind(&Form::__OnTransformsChanged, this);
         ObjectCreated.Unbind(&cf::Form::__OnObjectCreated, this);
         ObjectDeleted.Unbind(&cf::Form::__OnObjectDeleted, this);
+        PendingFlushed.Unbind(&cf::Form::__OnPendingFlushed, this);
     }
     
 };
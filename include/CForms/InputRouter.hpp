@@ -0,0 +1,278 @@
+#pragma once
+
+#include "Control.hpp"
+#include "Transform.hpp"
+#include "Event.hpp"
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+
+namespace cf {
+
+/// Router for the mouse and keyboard input of a cf::Form, which passes window events down to the control under the mouse or the focused control.
+/// Targets are found through the spatial indices of the form and its controls, so the cost depends on the nesting depth, not on the ammount of controls.
+/// Mouse moves are coalesced, and dispatched once per frame with the latest position.
+/// A control which was pressed captures the mouse until all buttons are released, so it receives moves and releases outside of its bounds too.
+class InputRouter {
+
+private:
+    
+    Control* m_hovered;
+    Control* m_focused;
+    Control* m_captured;
+    // transforms of the referenced controls, to recognize them once they are destroyed
+    Transform* m_hoveredtransform;
+    Transform* m_focusedtransform;
+    Transform* m_capturedtransform;
+    sf::Vector2i m_mouse;
+    uint32_t m_buttons;
+    bool m_moved;
+    
+public:
+    
+    /// Fired when the focused control was changed, through a click or SetFocus().
+    /// @param sender Router which fired the event.
+    /// @param control New focused control. Null if no control has the focus.
+    Event<InputRouter*, Control* const&> FocusChanged;
+    
+private:
+    
+    /// Internal call to count the references to a control, to bind to its destruction only once.
+    uint32_t __References(Control* control) const {
+        return uint32_t(m_hovered == control) + uint32_t(m_focused == control) + uint32_t(m_captured == control);
+    }
+    
+    /// Internal call to change a referenced control, and follow the destruction of referenced controls.
+    void __Set(Control*& slot, Transform*& transform, Control* control) {
+        if (slot == control) return;
+        Control* previous = slot;
+        Transform* previoustransform = transform;
+        slot = control;
+        transform = control ? control->Transform() : nullptr;
+        if (previous && __References(previous) == 0U) previoustransform->__Destroyed.Unbind(&InputRouter::__OnTargetDestroyed, this);
+        if (control && __References(control) == 1U) transform->__Destroyed.Bind(&InputRouter::__OnTargetDestroyed, this);
+    }
+    
+    /// Internal handler call to drop a destroyed control.
+    void __OnTargetDestroyed(Transform* transform) {
+        // the control itself is already destroyed at this point, so only the stored transforms are compared
+        if (m_hoveredtransform == transform) {
+            m_hovered = nullptr;
+            m_hoveredtransform = nullptr;
+        }
+        if (m_capturedtransform == transform) {
+            m_captured = nullptr;
+            m_capturedtransform = nullptr;
+            m_buttons = 0U;
+        }
+        if (m_focusedtransform == transform) {
+            m_focused = nullptr;
+            m_focusedtransform = nullptr;
+            FocusChanged(this, nullptr);
+        }
+    }
+    
+    /// Internal call to get the position of a control in window coordinates.
+    static sf::Vector2f __Origin(Control* control) {
+        sf::Vector2f origin;
+        for (; control; control = dynamic_cast<Control*>(control->Owner())) origin += control->Transform()->Position();
+        return origin;
+    }
+    
+    /// Internal call to find the innermost control at a window position, by descending through the hit tests of the root and its controls.
+    template<typename TRoot>
+    static Control* __Target(TRoot* root, const sf::Vector2i& position) {
+        sf::Vector2f point(position);
+        Control* target = nullptr;
+        Drawable* hit = root->HitTest(point);
+        while (Control* control = dynamic_cast<Control*>(hit)) {
+            target = control;
+            point -= control->Transform()->Position();
+            hit = control->HitTest(point);
+        }
+        return target;
+    }
+    
+    /// Internal call to move the mouse coordinates of an event by an offset.
+    static void __Offset(sf::Event& event, const sf::Vector2i& offset) {
+        switch (event.type) {
+            case sf::Event::MouseMoved:
+                event.mouseMove.x += offset.x;
+                event.mouseMove.y += offset.y;
+                break;
+            case sf::Event::MouseButtonPressed:
+            case sf::Event::MouseButtonReleased:
+                event.mouseButton.x += offset.x;
+                event.mouseButton.y += offset.y;
+                break;
+            case sf::Event::MouseWheelScrolled:
+                event.mouseWheelScroll.x += offset.x;
+                event.mouseWheelScroll.y += offset.y;
+                break;
+            default:
+                break;
+        }
+    }
+    
+    /// Internal call to pass an event to a control, then to its owner controls until one of them handles it.
+    /// Mouse coordinates are converted into the coordinates of each control.
+    static void __Send(Control* control, sf::Event event) {
+        if (!control) return;
+        sf::Vector2f origin = __Origin(control);
+        __Offset(event, -sf::Vector2i(int(origin.x), int(origin.y)));
+        while (control) {
+            if (control->InputEvent(event)) return;
+            sf::Vector2f position = control->Transform()->Position();
+            __Offset(event, sf::Vector2i(int(position.x), int(position.y)));
+            control = dynamic_cast<Control*>(control->Owner());
+        }
+    }
+    
+    /// Internal call to pass a notification without position to a single control.
+    static void __Notify(Control* control, sf::Event::EventType type) {
+        if (!control) return;
+        sf::Event event;
+        event.type = type;
+        control->InputEvent(event);
+    }
+    
+    /// Internal call to change the hovered control, and notify both controls.
+    void __Hover(Control* control) {
+        if (m_hovered == control) return;
+        Control* previous = m_hovered;
+        __Set(m_hovered, m_hoveredtransform, control);
+        __Notify(previous, sf::Event::MouseLeft);
+        __Notify(control, sf::Event::MouseEntered);
+    }
+    
+    /// Internal call to find the control which receives a mouse event at a window position.
+    template<typename TRoot>
+    Control* __MouseTarget(TRoot* root, const sf::Vector2i& position) {
+        if (m_captured) return m_captured;
+        Control* target = __Target(root, position);
+        __Hover(target);
+        return target;
+    }
+    
+public:
+    
+    /// Internal call to route a window event of the root, e.g. a form. Mouse moves are only collected, until the next Flush().
+    template<typename TRoot>
+    void __Handle(TRoot* root, const sf::Event& event) {
+        switch (event.type) {
+            case sf::Event::MouseMoved:
+                m_mouse = sf::Vector2i(event.mouseMove.x, event.mouseMove.y);
+                m_moved = true;
+                return;
+            case sf::Event::MouseButtonPressed: {
+                // pending moves go first, so every event is hit tested at its own position
+                __Flush(root);
+                m_mouse = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+                Control* target = __MouseTarget(root, m_mouse);
+                Control* focus = target;
+                while (focus && !focus->m_focusable) focus = dynamic_cast<Control*>(focus->Owner());
+                SetFocus(focus);
+                m_buttons |= 1U << uint32_t(event.mouseButton.button);
+                __Set(m_captured, m_capturedtransform, target);
+                __Send(target, event);
+                return;
+            }
+            case sf::Event::MouseButtonReleased: {
+                __Flush(root);
+                m_mouse = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+                Control* target = __MouseTarget(root, m_mouse);
+                m_buttons &= ~(1U << uint32_t(event.mouseButton.button));
+                if (m_buttons == 0U) __Set(m_captured, m_capturedtransform, nullptr);
+                __Send(target, event);
+                // the mouse may have left the released control meanwhile
+                if (!m_captured) __Hover(__Target(root, m_mouse));
+                return;
+            }
+            case sf::Event::MouseWheelScrolled:
+                __Flush(root);
+                __Send(__MouseTarget(root, sf::Vector2i(event.mouseWheelScroll.x, event.mouseWheelScroll.y)), event);
+                return;
+            case sf::Event::MouseLeft:
+                __Flush(root);
+                if (!m_captured) __Hover(nullptr);
+                return;
+            case sf::Event::KeyPressed:
+            case sf::Event::KeyReleased:
+            case sf::Event::TextEntered:
+                __Send(m_focused, event);
+                return;
+            case sf::Event::LostFocus:
+                // button releases outside of the window are never reported
+                m_buttons = 0U;
+                __Set(m_captured, m_capturedtransform, nullptr);
+                return;
+            default:
+                return;
+        }
+    }
+    
+    /// Internal call to dispatch the collected mouse move, once per frame.
+    template<typename TRoot>
+    void __Flush(TRoot* root) {
+        if (!m_moved) return;
+        m_moved = false;
+        sf::Event event;
+        event.type = sf::Event::MouseMoved;
+        event.mouseMove.x = m_mouse.x;
+        event.mouseMove.y = m_mouse.y;
+        __Send(__MouseTarget(root, m_mouse), event);
+    }
+    
+    /// Control under the mouse. Null if there is none.
+    Control* Hovered() const {
+        return m_hovered;
+    }
+    
+    /// Control which receives the keyboard input. Null if there is none.
+    Control* Focused() const {
+        return m_focused;
+    }
+    
+    /// Control which receives all mouse input while a button is held. Null if there is none.
+    Control* Captured() const {
+        return m_captured;
+    }
+    
+    /// Latest mouse position, in window coordinates.
+    const sf::Vector2i& MousePosition() const {
+        return m_mouse;
+    }
+    
+    /// Give the keyboard focus to a control. Null to clear the focus.
+    void SetFocus(Control* control) {
+        if (m_focused == control) return;
+        Control* previous = m_focused;
+        __Set(m_focused, m_focusedtransform, control);
+        __Notify(previous, sf::Event::LostFocus);
+        __Notify(control, sf::Event::GainedFocus);
+        FocusChanged(this, m_focused);
+    }
+    
+    InputRouter(const InputRouter&) = delete;
+    
+    InputRouter() {
+        m_hovered = nullptr;
+        m_focused = nullptr;
+        m_captured = nullptr;
+        m_hoveredtransform = nullptr;
+        m_focusedtransform = nullptr;
+        m_capturedtransform = nullptr;
+        m_buttons = 0U;
+        m_moved = false;
+    }
+    
+    ~InputRouter() {
+        __Set(m_hovered, m_hoveredtransform, nullptr);
+        __Set(m_focused, m_focusedtransform, nullptr);
+        __Set(m_captured, m_capturedtransform, nullptr);
+    }
+    
+};
+
+}
\ No newline at end of file
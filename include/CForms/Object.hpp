@@ -22,6 +22,7 @@ private:
 protected:
     
     /// Name of the object. Should be unique to its owner!
+    /// Change it through SetName() after creation, so the owner's name index stays valid.
     std::string m_name;
     
     /// Error state of the object. If greater than 0, the object will be locked out of application cycle.
@@ -32,6 +33,11 @@ public:
     /// Fired if the object encountered an error.
     Event<Object*, const uint32_t&> ErrorEncoutered;
     
+    /// Fired when the object's name was changed, through SetName().
+    /// @param sender Object which fired the event.
+    /// @param name New name of the object.
+    Event<Object*, const std::string&> NameChanged;
+    
 private:
     
     /// Internal call to generate an object ID.
@@ -86,13 +92,16 @@ public:
     
     /// Change the name of the object.
     void SetName(const std::string& name) {
+        if (m_name == name) return;
         m_name = name;
+        NameChanged(this, m_name);
     }
     
     /// Do not use constructors to create an object! Instead, use Create() from the object owner.
     Object(ObjectOwner* owner, const std::string& name) {
         m_id = __GenerateRuntimeID();
         m_owner = owner;
+        m_initialized = false;
         m_name = name;
         m_error = 0U;
     }
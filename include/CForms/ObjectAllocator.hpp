@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <cstddef>
+
+namespace cf {
+
+/// Memory source for objects created through cf::ObjectOwner::Create().
+/// Set one on an owner through SetAllocator(), e.g. a cf::PoolAllocator, so its objects do not go through malloc one by one.
+/// Child owners share the allocator of their owner, and the forms of a threaded cf::Application create and delete objects on their own threads.
+/// So Allocate() and Free() may be called from several threads at once, and have to be thread-safe.
+class ObjectAllocator {
+
+public:
+    
+    /// Get memory for a single object.
+    /// @param type cf::TypeID of the object type. Objects of the same type always have the same size and alignment.
+    /// @return Null on failure.
+    virtual void* Allocate(size_t size, size_t align, size_t type) = 0;
+    
+    /// Give back the memory of a single object, after it was destroyed.
+    virtual void Free(void* memory, size_t size, size_t align, size_t type) = 0;
+    
+    virtual ~ObjectAllocator() {}
+    
+};
+
+/// Allocator which gets the memory of every object from the heap. Default of every cf::ObjectOwner.
+class HeapAllocator : public ObjectAllocator {
+
+public:
+    
+    /// Shared instance, used by owners without an allocator of their own.
+    static const std::shared_ptr<ObjectAllocator>& Default() {
+        static const std::shared_ptr<ObjectAllocator> allocator = std::make_shared<HeapAllocator>();
+        return allocator;
+    }
+    
+    virtual void* Allocate(size_t size, size_t align, size_t type) override {
+        return ::operator new(size, std::align_val_t(align), std::nothrow);
+    }
+    
+    virtual void Free(void* memory, size_t size, size_t align, size_t type) override {
+        ::operator delete(memory, std::align_val_t(align));
+    }
+    
+    HeapAllocator() {}
+    
+    ~HeapAllocator() {}
+    
+};
+
+}
\ No newline at end of file
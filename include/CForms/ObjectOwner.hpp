@@ -3,24 +3,109 @@
 #include "Object.hpp"
 #include "Event.hpp"
 #include "Predicate.hpp"
+#include "TypeID.hpp"
+#include "ObjectAllocator.hpp"
 
 #include <vector>
 #include <memory>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <iostream>
+#include <functional>
+#include <mutex>
+#include <new>
 
 namespace cf {
 
 /// Base type for an object owner.
 class ObjectOwner : public virtual Object {
 
+public:
+    
+    /// Stable reference to an owned object.
+    /// A handle never resolves to another object, even after its object was deleted and the slot was reused.
+    struct Handle {
+        uint32_t index;
+        uint32_t generation;
+    };
+    
 private:
     
-    std::vector<std::unique_ptr<Object>> m_objects;
-    std::unordered_map<uint64_t, size_t> m_objectmap;
-    std::unordered_map<std::string, std::unordered_map<uint64_t, size_t>> m_typemap;
+    /// Destroys an owned object, and gives its memory back to the allocator it came from.
+    /// Objects are virtually derived from cf::Object, so the memory does not have to start at the cf::Object part.
+    struct Deleter {
+        ObjectAllocator* allocator;
+        void* memory;
+        size_t size;
+        size_t align;
+        size_t type;
+        
+        void operator()(Object* object) const {
+            object->~Object();
+            allocator->Free(memory, size, align, type);
+        }
+    };
+    
+    using ObjectPtr = std::unique_ptr<Object, Deleter>;
+    
+    struct Slot {
+        ObjectPtr object;
+        uint32_t generation;
+        size_t namehash;
+        std::vector<size_t> types;
+    };
+    
+    struct TypeBucketBase {
+        virtual ~TypeBucketBase() {}
+        virtual void Remove(uint32_t slot) = 0;
+    };
+    
+    /// Already cast pointers of all registered objects of type <T>.
+    template<typename T>
+    struct TypeBucket : public TypeBucketBase {
+        
+        static constexpr uint32_t None = UINT32_MAX;
+        
+        std::vector<T*> objects;
+        std::vector<uint32_t> slots;
+        std::vector<uint32_t> positions;
+        
+        void Add(uint32_t slot, T* object) {
+            if (slot >= positions.size()) positions.resize(slot + 1U, None);
+            if (positions[slot] != None) return;
+            positions[slot] = uint32_t(objects.size());
+            objects.push_back(object);
+            slots.push_back(slot);
+        }
+        
+        virtual void Remove(uint32_t slot) override {
+            if (slot >= positions.size() || positions[slot] == None) return;
+            uint32_t position = positions[slot];
+            objects[position] = objects.back();
+            slots[position] = slots.back();
+            positions[slots[position]] = position;
+            objects.pop_back();
+            slots.pop_back();
+            positions[slot] = None;
+        }
+    };
+    
+    // declared before the slots, so owned objects are destroyed while the allocator is still alive
+    std::shared_ptr<ObjectAllocator> m_allocator;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_free;
+    size_t m_count;
+    std::unordered_map<uint64_t, uint32_t> m_objectmap;
+    std::vector<std::unique_ptr<TypeBucketBase>> m_typemap;
+    std::unordered_map<size_t, std::vector<uint32_t>> m_namemap;
+    std::vector<Handle> m_pendingdeletes;
+    std::vector<std::function<void()>> m_pendingcreates;
+    std::vector<Handle> m_pendingowners;
+    bool m_pending;
+    bool m_flushing;
+    std::mutex m_pendingmutex;
 
 public:
     
@@ -39,6 +124,76 @@ public:
     /// @param object Object to be destroyed.
     Event<ObjectOwner*, Object*&> ObjectDeleted;
     
+    /// Fired after a batch of deferred deletions was processed. Objects deleted while flushing are already destroyed.
+    /// @param sender Owner which fired the Event.
+    Event<ObjectOwner*> PendingFlushed;
+    
+private:
+    
+    /// Internal call to get the bucket of type <T>. Null if no object of the type was registered yet.
+    template<typename T>
+    TypeBucket<T>* __FindBucket() const {
+        size_t type = TypeID::Of<T>();
+        if (type >= m_typemap.size()) return nullptr;
+        return static_cast<TypeBucket<T>*>(m_typemap[type].get());
+    }
+    
+    /// Internal call to add an object slot to the bucket of type <T>.
+    template<typename T>
+    void __RegisterSlot(uint32_t index, T* object) {
+        size_t type = TypeID::Of<T>();
+        if (type >= m_typemap.size()) m_typemap.resize(type + 1U);
+        if (!m_typemap[type]) m_typemap[type] = std::make_unique<TypeBucket<T>>();
+        static_cast<TypeBucket<T>*>(m_typemap[type].get())->Add(index, object);
+        auto& types = m_slots[index].types;
+        if (std::find(types.begin(), types.end(), type) == types.end()) types.push_back(type);
+    }
+    
+    /// Internal call to add an object slot to the name index.
+    void __IndexName(uint32_t index) {
+        Slot& slot = m_slots[index];
+        slot.namehash = std::hash<std::string_view>()(slot.object->Name());
+        m_namemap[slot.namehash].push_back(index);
+    }
+    
+    /// Internal call to remove an object slot from the name index.
+    void __UnindexName(uint32_t index) {
+        auto it = m_namemap.find(m_slots[index].namehash);
+        if (it == m_namemap.end()) return;
+        auto& indices = it->second;
+        indices.erase(std::find(indices.begin(), indices.end(), index));
+        if (indices.empty()) m_namemap.erase(it);
+    }
+    
+    /// Internal handler call to keep the name index valid, when an owned object was renamed.
+    void __OnObjectNameChanged(Object* object, const std::string& name) {
+        auto it = m_objectmap.find(object->ID());
+        if (it == m_objectmap.end()) return;
+        __UnindexName(it->second);
+        __IndexName(it->second);
+    }
+    
+    /// Internal call to mark the owner, and all owners above it, as having deferred work.
+    /// The pending mutex has to be held.
+    void __MarkPending() {
+        if (m_pending) return;
+        m_pending = true;
+        if (ObjectOwner* owner = Owner()) owner->__OnChildPending(this);
+    }
+    
+    /// Internal handler call to remember a child owner with deferred work.
+    void __OnChildPending(ObjectOwner* child) {
+        Handle handle;
+        if (!GetHandle(child, handle)) return;
+        std::lock_guard<std::mutex> lock(m_pendingmutex);
+        // children which flush themselves, e.g. forms of an application, would otherwise queue up again and again
+        for (const Handle& pending : m_pendingowners) {
+            if (pending.index == handle.index && pending.generation == handle.generation) return;
+        }
+        m_pendingowners.push_back(handle);
+        __MarkPending();
+    }
+    
 protected:
     
     /// Register an object type for use in the object owner's search functions.
@@ -51,8 +206,7 @@ protected:
             std::cerr << "[X] '" + m_name + "': Failed to register. Not the owner of object '" + object->Name() + "'.\n";
             return;
         }
-        std::string tname = typeid(TObject).name();
-        m_typemap[tname][object->ID()] = it->second;
+        __RegisterSlot<TObject>(it->second, object);
     }
     
     /// Delete an owned object.
@@ -62,12 +216,22 @@ protected:
             std::cerr << "[X] '" + m_name + "': Failed to delete. Not the owner of object \'" + std::string(object->Name()) + "\'.\n";
             return false;
         }
-        for (auto& m: m_typemap) {
-            m.second.erase(object->ID());
+        uint32_t index = it->second;
+        Slot& slot = m_slots[index];
+        for (auto& type : slot.types) {
+            m_typemap[type]->Remove(index);
         }
-        m_objectmap.erase(object->ID());
+        slot.types.clear();
+        __UnindexName(index);
+        m_objectmap.erase(it);
+        object->NameChanged.Unbind(&ObjectOwner::__OnObjectNameChanged, this);
         ObjectDeleted(this, object);
-        m_objects.erase(m_objects.begin() + it->second);
+        // move the object out first, destructors may create objects and grow the slots
+        ObjectPtr destroyed = std::move(m_slots[index].object);
+        destroyed.reset();
+        m_slots[index].generation++;
+        m_free.push_back(index);
+        m_count--;
         return true;
     }
     
@@ -76,18 +240,36 @@ protected:
     template<typename TObject>
     TObject* Create(const std::string& name) {
         static_assert(std::is_base_of<Object, TObject>::value, "TObject must inherit from cf::Object");
-        auto& ptr = m_objects.emplace_back(std::make_unique<TObject>(this, name));
-        if (!ptr) {
+        size_t type = TypeID::Of<TObject>();
+        void* memory = m_allocator->Allocate(sizeof(TObject), alignof(TObject), type);
+        if (!memory) {
             // ERROR Failed to allocate/create object
             std::cerr << "[X] '" + m_name + "': Failed to allocate/create object \'" + std::string(name) + "\'.\n";
             return nullptr;
         }
-        size_t index = m_objects.size() - 1;
-        uint64_t id = ptr->ID();
+        TObject* typed = new (memory) TObject(this, name);
+        ObjectPtr ptr(typed, Deleter{m_allocator.get(), memory, sizeof(TObject), alignof(TObject), type});
+        // child owners share the allocator before they can create objects in Init(), unless their constructor set one of their own
+        ObjectOwner* owner = dynamic_cast<ObjectOwner*>(ptr.get());
+        if (owner && owner->m_allocator == HeapAllocator::Default()) owner->m_allocator = m_allocator;
+        uint32_t index;
+        if (!m_free.empty()) {
+            index = m_free.back();
+            m_free.pop_back();
+        }
+        else {
+            index = uint32_t(m_slots.size());
+            m_slots.push_back(Slot{nullptr, 0U, 0U, {}});
+        }
+        Slot& slot = m_slots[index];
+        slot.object = std::move(ptr);
+        m_count++;
+        uint64_t id = slot.object->ID();
         m_objectmap[id] = index;
-        std::string tname = typeid(TObject).name();
-        m_typemap[tname][id] = index;
-        cf::Object* object = ptr.get();
+        __RegisterSlot<TObject>(index, typed);
+        __IndexName(index);
+        cf::Object* object = slot.object.get();
+        object->NameChanged.Bind(&ObjectOwner::__OnObjectNameChanged, this);
         ObjectCreated(this, object);
         if (!object->__InitCall()) {
             // ERROR Failed to initialize the object
@@ -96,14 +278,96 @@ protected:
             return nullptr;
         }
         ObjectInitialized(this, object);
-        return dynamic_cast<TObject*>(object);
+        return typed;
+    }
+    
+    /// Delete an owned object at the next flush of the form, instead of right away.
+    /// Use this while collections of the owner might be iterated, e.g. inside Update(). Safe to call from parallel updates.
+    bool DeleteLater(Object* object) {
+        Handle handle;
+        if (!GetHandle(object, handle)) {
+            std::cerr << "[X] '" + m_name + "': Failed to delete later. Not the owner of object \'" + std::string(object->Name()) + "\'.\n";
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_pendingmutex);
+        m_pendingdeletes.push_back(handle);
+        __MarkPending();
+        return true;
+    }
+    
+    /// Create new object of type <TObject> at the next flush of the form, instead of right away.
+    /// Use this while collections of the owner might be iterated, e.g. inside Update(). Safe to call from parallel updates.
+    /// @param name Name for the object. Should be unique inside its owner!
+    /// @param created Called with the new object, after it was created and initialized.
+    template<typename TObject>
+    void CreateLater(const std::string& name, std::function<void(TObject*)> created = nullptr) {
+        static_assert(std::is_base_of<Object, TObject>::value, "TObject must inherit from cf::Object");
+        std::lock_guard<std::mutex> lock(m_pendingmutex);
+        m_pendingcreates.push_back([this, name, created]() {
+            TObject* object = Create<TObject>(name);
+            if (object && created) created(object);
+        });
+        __MarkPending();
+    }
+    
+    /// True while a batch of deferred deletions is processed.
+    /// Deletion handlers can use this to defer the compaction of their collections until PendingFlushed.
+    bool IsFlushing() const {
+        return m_flushing;
     }
     
 public:
     
+    /// Internal call to process deferred deletions and creations of the owner and its child owners in one batch.
+    virtual void __FlushPending() {
+        std::vector<Handle> deletes;
+        std::vector<std::function<void()>> creates;
+        std::vector<Handle> owners;
+        {
+            std::lock_guard<std::mutex> lock(m_pendingmutex);
+            if (!m_pending) return;
+            m_pending = false;
+            deletes.swap(m_pendingdeletes);
+            creates.swap(m_pendingcreates);
+            owners.swap(m_pendingowners);
+        }
+        if (!deletes.empty()) {
+            m_flushing = true;
+            for (auto& handle : deletes) {
+                // queued twice or already deleted right away
+                if (Object* object = Get(handle)) Delete(object);
+            }
+            m_flushing = false;
+            PendingFlushed(this);
+        }
+        for (auto& create : creates) {
+            create();
+        }
+        for (auto& handle : owners) {
+            if (ObjectOwner* owner = dynamic_cast<ObjectOwner*>(Get(handle))) owner->__FlushPending();
+        }
+    }
+    
     /// Current ammount of owned objects 
     size_t ObjectCount() const {
-        return m_objects.size();
+        return m_count;
+    }
+    
+    /// Allocator of the owner's objects. Child owners created afterwards share it, unless they set their own.
+    const std::shared_ptr<ObjectAllocator>& Allocator() const {
+        return m_allocator;
+    }
+    
+    /// Change the allocator of the owner's objects, e.g. to a cf::PoolAllocator.
+    /// Only possible while the owner has no objects, e.g. in the constructor. The allocator is shared with child owners created afterwards,
+    /// unless their constructor sets one of their own.
+    bool SetAllocator(const std::shared_ptr<ObjectAllocator>& allocator) {
+        if (m_count != 0U || !m_slots.empty()) {
+            std::cerr << "[X] '" + m_name + "': Failed to change allocator. The owner already has objects.\n";
+            return false;
+        }
+        m_allocator = allocator ? allocator : HeapAllocator::Default();
+        return true;
     }
     
     /// Get object by ID.
@@ -113,14 +377,36 @@ public:
             return nullptr;
         }
         else {
-            return m_objects[it->second].get();
+            return m_slots[it->second].object.get();
         }
     }
     
+    /// Get object by handle. Null if the object was deleted.
+    Object* Get(const Handle& handle) {
+        if (handle.index >= m_slots.size()) return nullptr;
+        const Slot& slot = m_slots[handle.index];
+        if (slot.generation != handle.generation) return nullptr;
+        return slot.object.get();
+    }
+    
+    /// Get a stable handle of an owned object.
+    /// @param handle Handle of the object, if owned.
+    /// @return False if the object is not owned.
+    bool GetHandle(Object* object, Handle& handle) const {
+        auto it = m_objectmap.find(object->ID());
+        if (it == m_objectmap.end()) return false;
+        handle = Handle{it->second, m_slots[it->second].generation};
+        return true;
+    }
+    
     /// Get object by Name.
-    Object* Get(const std::string& name) {
-        for (auto& obj : m_objects) {
-            if (obj->Name() == name) return obj.get();
+    /// If several objects share the name, the one which took the name first is returned.
+    Object* Get(std::string_view name) {
+        auto it = m_namemap.find(std::hash<std::string_view>()(name));
+        if (it == m_namemap.end()) return nullptr;
+        for (auto& index : it->second) {
+            Object* object = m_slots[index].object.get();
+            if (object->Name() == name) return object;
         }
         return nullptr;
     }
@@ -129,25 +415,27 @@ public:
     /// <TObject> must be a registered type!
     template<typename TObject>
     std::vector<TObject*> GetAll() {
+        return All<TObject>();
+    }
+    
+    /// View of all objects of type <TObject>, without copying them.
+    /// <TObject> must be a registered type!
+    /// The view is owned by the object owner and changes when objects are created or deleted, so do not create or delete objects while iterating it. Use GetAll() for that.
+    template<typename TObject>
+    const std::vector<TObject*>& All() {
         static_assert(std::is_base_of<cf::Object, TObject>::value, "TObject must inherit from cf::Object");
-        std::vector<TObject*> result;
-        std::string t_id = typeid(TObject).name();
-        auto t_it = m_typemap.find(t_id);
-        if (t_it == m_typemap.end()) {
-            return result;
-        }
-        auto& t_om = t_it->second;
-        for (auto& index: t_om) {
-            TObject* obj = dynamic_cast<TObject*>(m_objects[index.second].get());
-            result.push_back(obj);    
+        static const std::vector<TObject*> empty;
+        TypeBucket<TObject>* bucket = __FindBucket<TObject>();
+        if (!bucket) {
+            return empty;
         }
-        return result;
+        return bucket->objects;
     }
     
     /// Find first object matching the comparison function.
     Object* Find(Predicate<Object>::Ptr p) {
-        for (auto& obj : m_objects) {
-            if (p(obj.get())) return obj.get();
+        for (auto& slot : m_slots) {
+            if (slot.object && p(slot.object.get())) return slot.object.get();
         }
         return nullptr;
     }
@@ -157,16 +445,12 @@ public:
     template<typename TObject>
     TObject* Find(typename Predicate<TObject>::Ptr p) {
         static_assert(std::is_base_of<cf::Object, TObject>::value, "TObject must inherit from cf::Object");
-        std::string t_id = typeid(TObject).name();
-        auto t_it = m_typemap.find(t_id);
-        if (t_it == m_typemap.end()) {
+        TypeBucket<TObject>* bucket = __FindBucket<TObject>();
+        if (!bucket) {
             return nullptr;
         }
-        auto& t_om = t_it->second;
-        
-        for (auto& index: t_om) {
-            TObject* obj = dynamic_cast<TObject*>(m_objects[index.second].get());
-            if (obj && p(obj))
+        for (TObject* obj : bucket->objects) {
+            if (p(obj))
                 return obj;
         }
         return nullptr;
@@ -175,12 +459,10 @@ public:
     /// Find all objects matching the comparison function.
     std::vector<Object*> FindAll(Predicate<Object>::Ptr p) {
         std::vector<cf::Object*> result;
-        auto it = m_objects.begin();
-        while (it != m_objects.end()) {
-            if (p(it->get())) {
-                result.push_back(it->get());
+        for (auto& slot : m_slots) {
+            if (slot.object && p(slot.object.get())) {
+                result.push_back(slot.object.get());
             }
-            ++it;
         }
         return result;
     }
@@ -191,15 +473,12 @@ public:
     std::vector<TObject*> FindAll(typename Predicate<TObject>::Ptr p) {
         static_assert(std::is_base_of<cf::Object, TObject>::value, "TObject must inherit from cf::Object");
         std::vector<TObject*> result;
-        std::string t_id = typeid(TObject).name();
-        auto t_it = m_typemap.find(t_id);
-        if (t_it == m_typemap.end()) {
+        TypeBucket<TObject>* bucket = __FindBucket<TObject>();
+        if (!bucket) {
             return result;
         }
-        auto& t_om = t_it->second;
-        for (auto& index: t_om) {
-            TObject* obj = dynamic_cast<TObject*>(m_objects[index.second].get());
-            if (obj && p(obj))
+        for (TObject* obj : bucket->objects) {
+            if (p(obj))
                 result.push_back(obj);
         }
         return result;
@@ -207,7 +486,12 @@ public:
     
     /// Do not use this constructor!
     /// Types derived from cf::ObjectOwner should call cf::Object(owner, name) or cf::Object(name) on their constructor!
-    ObjectOwner() {}
+    ObjectOwner() {
+        m_allocator = HeapAllocator::Default();
+        m_count = 0U;
+        m_pending = false;
+        m_flushing = false;
+    }
     
     virtual ~ObjectOwner() {}
     
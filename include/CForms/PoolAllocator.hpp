@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ObjectAllocator.hpp"
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+
+namespace cf {
+
+/// Allocator with one pool per object type, which hands out blocks of larger chunks.
+/// Objects of the same type lie next to each other in memory, and creating or deleting them never calls malloc once the pool is warm.
+/// Chunks are only released when the allocator is destroyed, so it has to outlive all owners using it.
+/// Pools are guarded by a mutex, so one allocator can be shared by the forms of a threaded cf::Application.
+class PoolAllocator : public ObjectAllocator {
+
+private:
+    
+    struct Block {
+        Block* next;
+    };
+    
+    struct Pool {
+        size_t size;
+        size_t align;
+        std::vector<void*> chunks;
+        Block* free;
+        size_t used;
+    };
+    
+    std::vector<std::unique_ptr<Pool>> m_pools;
+    size_t m_chunkobjects;
+    mutable std::mutex m_mutex;
+    
+private:
+    
+    /// Internal call to add a chunk to a pool, and put all of its blocks on the free list in address order.
+    bool __Grow(Pool& pool) {
+        size_t count = std::max<size_t>(m_chunkobjects, 1U);
+        char* chunk = static_cast<char*>(::operator new(pool.size * count, std::align_val_t(pool.align), std::nothrow));
+        if (!chunk) return false;
+        pool.chunks.push_back(chunk);
+        for (size_t i = count; i > 0U; --i) {
+            Block* block = reinterpret_cast<Block*>(chunk + (i - 1U) * pool.size);
+            block->next = pool.free;
+            pool.free = block;
+        }
+        return true;
+    }
+    
+public:
+    
+    virtual void* Allocate(size_t size, size_t align, size_t type) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (type >= m_pools.size()) m_pools.resize(type + 1U);
+        if (!m_pools[type]) {
+            // blocks double as free list nodes, and every block of a chunk has to stay aligned
+            align = std::max(align, alignof(Block));
+            size = std::max(size, sizeof(Block));
+            size = (size + align - 1U) / align * align;
+            m_pools[type] = std::make_unique<Pool>(Pool{size, align, {}, nullptr, 0U});
+        }
+        Pool& pool = *m_pools[type];
+        if (!pool.free && !__Grow(pool)) return nullptr;
+        Block* block = pool.free;
+        pool.free = block->next;
+        pool.used++;
+        return block;
+    }
+    
+    virtual void Free(void* memory, size_t size, size_t align, size_t type) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Pool& pool = *m_pools[type];
+        Block* block = static_cast<Block*>(memory);
+        block->next = pool.free;
+        pool.free = block;
+        pool.used--;
+    }
+    
+    /// Ammount of objects of a type currently allocated, by cf::TypeID.
+    size_t UsedCount(size_t type) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (type >= m_pools.size() || !m_pools[type]) return 0U;
+        return m_pools[type]->used;
+    }
+    
+    /// Ammount of bytes reserved by all pools.
+    size_t ReservedBytes() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t bytes = 0U;
+        for (const auto& pool : m_pools) {
+            if (pool) bytes += pool->chunks.size() * pool->size * std::max<size_t>(m_chunkobjects, 1U);
+        }
+        return bytes;
+    }
+    
+    PoolAllocator(const PoolAllocator&) = delete;
+    
+    /// @param chunkobjects Ammount of objects per chunk. Larger chunks call malloc less often, but reserve more unused memory.
+    PoolAllocator(size_t chunkobjects) {
+        m_chunkobjects = chunkobjects;
+    }
+    
+    PoolAllocator() : PoolAllocator(64U) {}
+    
+    ~PoolAllocator() {
+        for (const auto& pool : m_pools) {
+            if (!pool) continue;
+            for (void* chunk : pool->chunks) ::operator delete(chunk, std::align_val_t(pool->align));
+        }
+    }
+    
+};
+
+}
\ No newline at end of file
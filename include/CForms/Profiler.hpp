@@ -0,0 +1,317 @@
+#pragma once
+
+#include "Object.hpp"
+#include "ObjectOwner.hpp"
+#include "TraceRecorder.hpp"
+
+#include <SFML/System.hpp>
+
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+
+namespace cf {
+
+/// Statistics of a single timing over the recorded frames of a cf::Profiler.
+struct ProfileStats {
+    
+    /// Shortest recorded frame.
+    sf::Time min;
+    
+    /// Average over all recorded frames.
+    sf::Time avg;
+    
+    /// 99th percentile of all recorded frames.
+    sf::Time p99;
+    
+    /// Longest recorded frame.
+    sf::Time max;
+    
+};
+
+/// Per frame timings of a single object, as returned by cf::Form::Profile().
+/// Self timings only cover the object itself, subtree timings include all of its child objects.
+struct ProfileEntry {
+    
+    /// ID of the object.
+    uint64_t id;
+    
+    /// ID of the object's owner. 0 if the owner is the form.
+    uint64_t owner;
+    
+    /// Name of the object.
+    std::string name;
+    
+    /// Ammount of recorded frames.
+    size_t frames;
+    
+    /// Update() of the object itself.
+    ProfileStats update;
+    
+    /// Update of the object, including all child objects.
+    ProfileStats subtree_update;
+    
+    /// Draw() of the object itself.
+    ProfileStats draw;
+    
+    /// Drawing of the object, including all child objects and compositing.
+    ProfileStats subtree_draw;
+    
+    /// Compositing of the object's child objects into its canvas.
+    ProfileStats composite;
+    
+};
+
+/// Low-overhead timing recorder for all objects of a cf::Form.
+/// While recording, every object keeps the timings of its recent frames in a ring buffer, so statistics are available at any time.
+/// Objects only get a record while timings are recorded or single objects are traced, so forms which never profile pay nothing per object.
+class Profiler {
+
+public:
+    
+    enum Metric : uint8_t {
+        UpdateSelf,
+        UpdateTotal,
+        DrawSelf,
+        DrawTotal,
+        Composite,
+        MetricCount
+    };
+    
+    /// Ammount of frames kept per object.
+    static constexpr size_t Frames = 128U;
+    
+private:
+    
+    struct Record {
+        Object* object;
+        Record* parent;
+        size_t position;
+        std::vector<Record*> children;
+        bool selfupdate;
+        bool selfdraw;
+        uint32_t current[MetricCount];
+        uint32_t samples[MetricCount][Frames];
+    };
+    
+    std::unordered_map<const Object*, std::unique_ptr<Record>> m_records;
+    std::shared_ptr<TraceRecorder> m_trace;
+    size_t m_frame;
+    size_t m_frames;
+    bool m_enabled;
+    
+private:
+    
+    /// Internal call to compute statistics of a ring buffer, in nanoseconds.
+    static ProfileStats __Stats(const uint32_t* samples, size_t count) {
+        ProfileStats stats;
+        if (count == 0U) return stats;
+        std::vector<uint32_t> sorted(samples, samples + count);
+        std::sort(sorted.begin(), sorted.end());
+        uint64_t sum = 0U;
+        for (uint32_t sample : sorted) sum += sample;
+        size_t p99 = std::min(count - 1U, (count * 99U) / 100U);
+        stats.min = sf::microseconds(sorted.front() / 1000U);
+        stats.avg = sf::microseconds(int64_t(sum / count) / 1000);
+        stats.p99 = sf::microseconds(sorted[p99] / 1000U);
+        stats.max = sf::microseconds(sorted.back() / 1000U);
+        return stats;
+    }
+    
+public:
+    
+    /// Measures the time from its construction to its destruction, and adds it to a timing of an object.
+    /// The time is also recorded as a trace event, if the profiler's trace recorder records single objects.
+    class Scope {
+    
+    private:
+        
+        uint32_t* m_target;
+        TraceRecorder* m_trace;
+        const char* m_category;
+        const std::string* m_name;
+        std::chrono::steady_clock::time_point m_start;
+    
+    public:
+        
+        /// @param profiler Profiler to record into. Nothing is measured if null, disabled and not tracing single objects.
+        Scope(Profiler* profiler, const Object* object, Metric metric) {
+            static const char* categories[MetricCount] = {"update.self", "update", "draw.self", "draw", "composite"};
+            m_target = nullptr;
+            m_trace = nullptr;
+            if (!profiler) return;
+            bool tracing = profiler->m_trace && profiler->m_trace->RecordsObjects();
+            if (!profiler->m_enabled && !tracing) return;
+            auto it = profiler->m_records.find(object);
+            if (it == profiler->m_records.end()) return;
+            Record& record = *it->second;
+            if (metric == UpdateSelf) record.selfupdate = true;
+            if (metric == DrawSelf) record.selfdraw = true;
+            if (profiler->m_enabled) m_target = &record.current[metric];
+            if (tracing) {
+                m_trace = profiler->m_trace.get();
+                m_category = categories[metric];
+                m_name = &record.object->Name();
+            }
+            m_start = std::chrono::steady_clock::now();
+        }
+        
+        Scope(const Scope&) = delete;
+        
+        ~Scope() {
+            if (!m_target && !m_trace) return;
+            auto end = std::chrono::steady_clock::now();
+            if (m_target) {
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start).count();
+                *m_target = uint32_t(std::min<int64_t>(int64_t(*m_target) + ns, UINT32_MAX));
+            }
+            if (m_trace) m_trace->Add(m_category, m_name->c_str(), m_start, end);
+        }
+    
+    };
+    
+    /// True if objects need records, because timings are recorded or single objects are traced.
+    bool IsActive() const {
+        return m_enabled || (m_trace && m_trace->RecordsObjects());
+    }
+    
+    /// Start recording the timings of an object. Ignored while the profiler is not active. Must not be called while objects are measured.
+    void Register(Object* object) {
+        if (!IsActive() || m_records.count(object) != 0U) return;
+        auto record = std::make_unique<Record>();
+        record->object = object;
+        auto parent = m_records.find(dynamic_cast<Object*>(object->Owner()));
+        record->parent = parent != m_records.end() ? parent->second.get() : nullptr;
+        record->position = 0U;
+        if (record->parent) {
+            record->position = record->parent->children.size();
+            record->parent->children.push_back(record.get());
+        }
+        record->selfupdate = false;
+        record->selfdraw = false;
+        std::fill(&record->current[0], &record->current[0] + MetricCount, 0U);
+        std::fill(&record->samples[0][0], &record->samples[0][0] + MetricCount * Frames, 0U);
+        m_records[object] = std::move(record);
+    }
+    
+    /// Register all objects below an owner, e.g. the objects of a form which existed before recording started.
+    void RegisterAll(ObjectOwner* owner) {
+        if (!IsActive()) return;
+        for (Object* object : owner->FindAll([](Object*) { return true; })) {
+            Register(object);
+            if (ObjectOwner* child = dynamic_cast<ObjectOwner*>(object)) RegisterAll(child);
+        }
+    }
+    
+    /// Stop recording the timings of an object and all of its child objects. Must not be called while objects are measured.
+    void Unregister(Object* object) {
+        auto it = m_records.find(object);
+        if (it == m_records.end()) return;
+        Record* record = it->second.get();
+        if (record->parent) {
+            std::vector<Record*>& siblings = record->parent->children;
+            siblings[record->position] = siblings.back();
+            siblings[record->position]->position = record->position;
+            siblings.pop_back();
+        }
+        // child objects are destroyed along with their owner, without being deleted one by one
+        std::vector<Record*> removed{record};
+        while (!removed.empty()) {
+            record = removed.back();
+            removed.pop_back();
+            removed.insert(removed.end(), record->children.begin(), record->children.end());
+            m_records.erase(record->object);
+        }
+    }
+    
+    /// Drop the records of all objects, e.g. after recording stopped.
+    void Clear() {
+        m_records.clear();
+    }
+    
+    /// Store the timings of the current frame in the ring buffers, and start a new frame.
+    void EndFrame() {
+        if (!m_enabled) return;
+        for (auto& entry : m_records) {
+            Record& record = *entry.second;
+            // objects without children are not measured separately
+            if (!record.selfupdate) record.current[UpdateSelf] = record.current[UpdateTotal];
+            if (!record.selfdraw) record.current[DrawSelf] = record.current[DrawTotal];
+            for (size_t metric = 0; metric < MetricCount; ++metric) {
+                record.samples[metric][m_frame] = record.current[metric];
+                record.current[metric] = 0U;
+            }
+        }
+        m_frame = (m_frame + 1U) % Frames;
+        m_frames = std::min(m_frames + 1U, Frames);
+    }
+    
+    /// Statistics of all recorded objects, sorted by their own average cost per frame, most expensive first.
+    /// @param count Maximum ammount of entries.
+    std::vector<ProfileEntry> Query(size_t count = SIZE_MAX) const {
+        std::vector<ProfileEntry> result;
+        if (m_frames == 0U) return result;
+        result.reserve(m_records.size());
+        for (const auto& entry : m_records) {
+            const Record& record = *entry.second;
+            ProfileEntry profile;
+            profile.id = record.object->ID();
+            profile.owner = record.parent ? record.parent->object->ID() : 0U;
+            profile.name = std::string(record.object->Name());
+            profile.frames = m_frames;
+            profile.update = __Stats(record.samples[UpdateSelf], m_frames);
+            profile.subtree_update = __Stats(record.samples[UpdateTotal], m_frames);
+            profile.draw = __Stats(record.samples[DrawSelf], m_frames);
+            profile.subtree_draw = __Stats(record.samples[DrawTotal], m_frames);
+            profile.composite = __Stats(record.samples[Composite], m_frames);
+            result.push_back(std::move(profile));
+        }
+        std::sort(result.begin(), result.end(), [](const ProfileEntry& a, const ProfileEntry& b) {
+            return a.update.avg + a.draw.avg + a.composite.avg > b.update.avg + b.draw.avg + b.composite.avg;
+        });
+        if (result.size() > count) result.resize(count);
+        return result;
+    }
+    
+    /// Discard all recorded frames.
+    void Reset() {
+        for (auto& entry : m_records) {
+            std::fill(&entry.second->current[0], &entry.second->current[0] + MetricCount, 0U);
+        }
+        m_frame = 0U;
+        m_frames = 0U;
+    }
+    
+    /// Turn recording on or off. Objects which existed before have to be registered through RegisterAll() afterwards.
+    void SetEnabled(bool enabled) {
+        if (enabled && !m_enabled) Reset();
+        m_enabled = enabled;
+    }
+    
+    /// True if timings are recorded.
+    bool IsEnabled() const {
+        return m_enabled;
+    }
+    
+    /// Change the trace recorder, which receives the measured scopes of single objects while it records them.
+    void SetTrace(const std::shared_ptr<TraceRecorder>& trace) {
+        m_trace = trace;
+    }
+    
+    Profiler(const Profiler&) = delete;
+    
+    Profiler() {
+        m_frame = 0U;
+        m_frames = 0U;
+        m_enabled = false;
+    }
+    
+    ~Profiler() {}
+    
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <string>
+#include <iostream>
+#include <mutex>
+
+namespace cf {
+
+/// Storage type for textures and fonts loaded from files, shared by all forms of a cf::Application.
+/// Every file is loaded once, no matter how many forms use it. SFML shares OpenGL resources between all windows, so textures can be drawn into any form.
+/// Loading is safe from the threads of all forms.
+class ResourceCache {
+
+private:
+    
+    std::unordered_map<std::string, std::shared_ptr<sf::Texture>> m_textures;
+    std::unordered_map<std::string, std::shared_ptr<sf::Font>> m_fonts;
+    std::mutex m_mutex;
+    
+private:
+    
+    /// Internal call to look up a resource, or load it on the first request.
+    template<typename TResource>
+    std::shared_ptr<const TResource> __Get(std::unordered_map<std::string, std::shared_ptr<TResource>>& map, const std::string& path, const char* kind) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = map.find(path);
+        if (it != map.end()) return it->second;
+        auto resource = std::make_shared<TResource>();
+        if (!resource->loadFromFile(path)) {
+            std::cerr << "[X] ResourceCache: Failed to load " + std::string(kind) + " '" + path + "'.\n";
+            return nullptr;
+        }
+        map.emplace(path, resource);
+        return resource;
+    }
+    
+    /// Internal call to drop the resources of a map which are not used outside of the cache.
+    template<typename TResource>
+    static size_t __Prune(std::unordered_map<std::string, std::shared_ptr<TResource>>& map) {
+        size_t dropped = 0U;
+        for (auto it = map.begin(); it != map.end();) {
+            if (it->second.use_count() > 1) {
+                ++it;
+                continue;
+            }
+            it = map.erase(it);
+            dropped++;
+        }
+        return dropped;
+    }
+    
+public:
+    
+    /// Texture loaded from an image file. Null if the file can not be loaded.
+    std::shared_ptr<const sf::Texture> Texture(const std::string& path) {
+        return __Get(m_textures, path, "texture");
+    }
+    
+    /// Font loaded from a font file. Null if the file can not be loaded.
+    /// The font file is read lazily by SFML, so it has to stay on disk while the font is used.
+    std::shared_ptr<const sf::Font> Font(const std::string& path) {
+        return __Get(m_fonts, path, "font");
+    }
+    
+    /// Drop all resources which are not used anymore outside of the cache.
+    /// @return Ammount of dropped resources.
+    size_t Prune() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return __Prune(m_textures) + __Prune(m_fonts);
+    }
+    
+    /// Ammount of cached resources.
+    size_t Count() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_textures.size() + m_fonts.size();
+    }
+    
+    ResourceCache(const ResourceCache&) = delete;
+    
+    ResourceCache() {}
+    
+    ~ResourceCache() {}
+    
+};
+
+}
\ No newline at end of file
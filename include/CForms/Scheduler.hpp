@@ -0,0 +1,146 @@
+#pragma once
+
+#include <SFML/System.hpp>
+
+#include <functional>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+namespace cf {
+
+/// Timers and frame requests of a cf::Form, shared with its updatable objects.
+/// In idle mode, the form only runs frames while something is dirty, a frame was requested or a timer is due.
+class Scheduler {
+
+public:
+    
+    /// Function called when a timer is due.
+    using Callback = std::function<void()>;
+    
+private:
+    
+    struct Timer {
+        sf::Time due;
+        sf::Time interval;
+        uint64_t id;
+        Callback callback;
+    };
+    
+    /// Orders the timer heap by due time, earliest first.
+    static bool __Later(const Timer& a, const Timer& b) {
+        return a.due > b.due;
+    }
+    
+    sf::Clock m_clock;
+    sf::Time m_updatetime;
+    std::vector<Timer> m_timers;
+    std::unordered_set<uint64_t> m_live;
+    uint64_t m_nextid;
+    std::atomic<bool> m_framerequested;
+    std::mutex m_mutex;
+    
+private:
+    
+    /// Internal call to drop cancelled timers from the top of the heap. The mutex has to be held.
+    void __DropCancelled() {
+        while (!m_timers.empty() && m_live.count(m_timers.front().id) == 0U) {
+            std::pop_heap(m_timers.begin(), m_timers.end(), &Scheduler::__Later);
+            m_timers.pop_back();
+        }
+    }
+    
+public:
+    
+    /// Call a function once after a delay, or repeatedly in an interval. Timers are run on the form's thread, before its update.
+    /// Cancel the timer before anything the function refers to is destroyed. Safe to call from parallel updates.
+    /// @param repeat If true, the function is called every delay, until the timer is cancelled.
+    /// @return ID of the timer, to cancel it.
+    uint64_t SetTimer(const sf::Time& delay, Callback callback, bool repeat = false) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t id = ++m_nextid;
+        sf::Time interval = repeat ? std::max(delay, sf::microseconds(1)) : sf::Time::Zero;
+        m_timers.push_back(Timer{Now() + delay, interval, id, std::move(callback)});
+        std::push_heap(m_timers.begin(), m_timers.end(), &Scheduler::__Later);
+        m_live.insert(id);
+        return id;
+    }
+    
+    /// Cancel a timer. Returns false if the timer is unknown or already ran out. Safe to call from timer functions.
+    bool CancelTimer(uint64_t id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_live.erase(id) != 0U;
+    }
+    
+    /// Request one more frame of the form, e.g. while animating. Safe to call from parallel updates.
+    void RequestFrame() {
+        m_framerequested.store(true, std::memory_order_relaxed);
+    }
+    
+    /// True if a frame was requested since the current frame started.
+    bool IsFrameRequested() const {
+        return m_framerequested.load(std::memory_order_relaxed);
+    }
+    
+    /// Time until the next timer is due. Returns false if there is no timer.
+    bool NextTimer(sf::Time& wait) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        __DropCancelled();
+        if (m_timers.empty()) return false;
+        wait = m_timers.front().due - Now();
+        return true;
+    }
+    
+    /// Start a frame of the form. Clears the frame request, and runs all due timers.
+    void BeginFrame() {
+        m_framerequested.store(false, std::memory_order_relaxed);
+        sf::Time now = Now();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            __DropCancelled();
+            if (m_timers.empty() || m_timers.front().due > now) break;
+            std::pop_heap(m_timers.begin(), m_timers.end(), &Scheduler::__Later);
+            Timer timer = std::move(m_timers.back());
+            m_timers.pop_back();
+            if (timer.interval == sf::Time::Zero) m_live.erase(timer.id);
+            // called without the lock, so the function can set and cancel timers
+            lock.unlock();
+            timer.callback();
+            lock.lock();
+            if (timer.interval == sf::Time::Zero || m_live.count(timer.id) == 0U) continue;
+            // late timers skip the missed calls, instead of catching up in a burst
+            timer.due = std::max(timer.due + timer.interval, now + sf::microseconds(1));
+            m_timers.push_back(std::move(timer));
+            std::push_heap(m_timers.begin(), m_timers.end(), &Scheduler::__Later);
+        }
+    }
+    
+    /// Current time of the scheduler.
+    sf::Time Now() const {
+        return m_clock.getElapsedTime();
+    }
+    
+    /// Add the delta of an update step of the form, before its objects are updated.
+    void AdvanceUpdate(const sf::Time& delta) {
+        m_updatetime += delta;
+    }
+    
+    /// Sum of the deltas of all update steps so far. Unlike Now(), this follows the fixed timestep and excludes idle sleep.
+    const sf::Time& UpdateTime() const {
+        return m_updatetime;
+    }
+    
+    Scheduler(const Scheduler&) = delete;
+    
+    Scheduler() : m_framerequested(false) {
+        m_nextid = 0U;
+    }
+    
+    ~Scheduler() {}
+    
+};
+
+}
\ No newline at end of file
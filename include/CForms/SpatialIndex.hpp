@@ -0,0 +1,245 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+namespace cf {
+
+/// Uniform grid over the bounds of objects, for region queries and hit-testing.
+/// An index does not claim ownership of its contents!
+/// Queries reuse internal buffers, so an index must not be queried from several threads at once.
+/// Query results are sorted by insertion order, which is the drawing order of cf::Form and cf::Control.
+template<typename T>
+class SpatialIndex {
+
+private:
+    
+    struct Entry {
+        T* item;
+        sf::FloatRect bounds;
+        uint64_t order;
+        uint64_t stamp;
+        int32_t left;
+        int32_t top;
+        int32_t right;
+        int32_t bottom;
+        bool large;
+    };
+    
+    /// Objects covering more cells than this are kept in a separate list instead of the grid.
+    static constexpr int64_t LargeCells = 64;
+    
+    std::unordered_map<T*, Entry> m_entries;
+    std::unordered_map<uint64_t, std::vector<Entry*>> m_cells;
+    std::vector<Entry*> m_large;
+    std::vector<Entry*> m_candidates;
+    float m_cellsize;
+    uint64_t m_order;
+    uint64_t m_stamp;
+    
+private:
+    
+    /// Internal call to get the key of a grid cell.
+    static uint64_t __Key(int32_t x, int32_t y) {
+        return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y));
+    }
+    
+    /// Internal call to get the grid cell of a coordinate.
+    int32_t __Cell(float value) const {
+        return int32_t(std::floor(value / m_cellsize));
+    }
+    
+    /// Internal call to put an entry into the grid cells covered by its bounds.
+    void __Link(Entry& entry) {
+        entry.left = __Cell(entry.bounds.left);
+        entry.top = __Cell(entry.bounds.top);
+        entry.right = __Cell(entry.bounds.left + entry.bounds.width);
+        entry.bottom = __Cell(entry.bounds.top + entry.bounds.height);
+        int64_t cells = (int64_t(entry.right) - entry.left + 1) * (int64_t(entry.bottom) - entry.top + 1);
+        entry.large = cells > LargeCells;
+        if (entry.large) {
+            m_large.push_back(&entry);
+            return;
+        }
+        for (int32_t y = entry.top; y <= entry.bottom; ++y) {
+            for (int32_t x = entry.left; x <= entry.right; ++x) {
+                m_cells[__Key(x, y)].push_back(&entry);
+            }
+        }
+    }
+    
+    /// Internal call to remove an entry from its grid cells.
+    void __Unlink(Entry& entry) {
+        auto remove = [&entry](std::vector<Entry*>& list) {
+            auto it = std::find(list.begin(), list.end(), &entry);
+            if (it == list.end()) return;
+            *it = list.back();
+            list.pop_back();
+        };
+        if (entry.large) {
+            remove(m_large);
+            return;
+        }
+        for (int32_t y = entry.top; y <= entry.bottom; ++y) {
+            for (int32_t x = entry.left; x <= entry.right; ++x) {
+                auto it = m_cells.find(__Key(x, y));
+                if (it == m_cells.end()) continue;
+                remove(it->second);
+                if (it->second.empty()) m_cells.erase(it);
+            }
+        }
+    }
+    
+    /// Internal call to collect the candidates of a cell range, without duplicates.
+    void __Collect(int32_t left, int32_t top, int32_t right, int32_t bottom, std::vector<Entry*>& result) {
+        m_stamp++;
+        for (Entry* entry : m_large) {
+            entry->stamp = m_stamp;
+            result.push_back(entry);
+        }
+        for (int32_t y = top; y <= bottom; ++y) {
+            for (int32_t x = left; x <= right; ++x) {
+                auto it = m_cells.find(__Key(x, y));
+                if (it == m_cells.end()) continue;
+                for (Entry* entry : it->second) {
+                    if (entry->stamp == m_stamp) continue;
+                    entry->stamp = m_stamp;
+                    result.push_back(entry);
+                }
+            }
+        }
+    }
+    
+    /// Internal call to write sorted items of the given entries into the result.
+    static void __Sort(std::vector<Entry*>& entries, std::vector<T*>& result) {
+        std::sort(entries.begin(), entries.end(), [](Entry* a, Entry* b) { return a->order < b->order; });
+        result.clear();
+        for (Entry* entry : entries) {
+            result.push_back(entry->item);
+        }
+    }
+    
+public:
+    
+    /// Add an item with the given bounds. Returns false if the item is already present.
+    bool Insert(T* item, const sf::FloatRect& bounds) {
+        auto result = m_entries.emplace(item, Entry{item, bounds, m_order++, 0U, 0, 0, 0, 0, false});
+        if (!result.second) return false;
+        __Link(result.first->second);
+        return true;
+    }
+    
+    /// Change the bounds of an item. Returns false if the item is not present.
+    bool Update(T* item, const sf::FloatRect& bounds) {
+        auto it = m_entries.find(item);
+        if (it == m_entries.end()) return false;
+        Entry& entry = it->second;
+        entry.bounds = bounds;
+        int32_t left = __Cell(bounds.left);
+        int32_t top = __Cell(bounds.top);
+        int32_t right = __Cell(bounds.left + bounds.width);
+        int32_t bottom = __Cell(bounds.top + bounds.height);
+        // most moves stay inside the same cells
+        if (left == entry.left && top == entry.top && right == entry.right && bottom == entry.bottom) return true;
+        __Unlink(entry);
+        __Link(entry);
+        return true;
+    }
+    
+    /// Remove an item. Returns false if the item is not present.
+    bool Remove(T* item) {
+        auto it = m_entries.find(item);
+        if (it == m_entries.end()) return false;
+        __Unlink(it->second);
+        m_entries.erase(it);
+        return true;
+    }
+    
+    /// Remove all items.
+    void Clear() {
+        m_entries.clear();
+        m_cells.clear();
+        m_large.clear();
+        m_candidates.clear();
+    }
+    
+    /// Current number of items.
+    size_t Count() const {
+        return m_entries.size();
+    }
+    
+    /// Collect all items intersecting the given rectangle, in insertion order.
+    void Query(const sf::FloatRect& rect, std::vector<T*>& result) {
+        // the candidates buffer is kept, as this runs for every culled draw call
+        m_candidates.clear();
+        __Collect(__Cell(rect.left), __Cell(rect.top), __Cell(rect.left + rect.width), __Cell(rect.top + rect.height), m_candidates);
+        m_candidates.erase(std::remove_if(m_candidates.begin(), m_candidates.end(), [&rect](Entry* entry) {
+            return !entry->bounds.intersects(rect);
+        }), m_candidates.end());
+        __Sort(m_candidates, result);
+    }
+    
+    /// All items intersecting the given rectangle, in insertion order.
+    std::vector<T*> Query(const sf::FloatRect& rect) {
+        std::vector<T*> result;
+        Query(rect, result);
+        return result;
+    }
+    
+    /// Collect all items containing the given point, in insertion order.
+    void QueryPoint(const sf::Vector2f& point, std::vector<T*>& result) {
+        m_candidates.clear();
+        int32_t x = __Cell(point.x);
+        int32_t y = __Cell(point.y);
+        __Collect(x, y, x, y, m_candidates);
+        m_candidates.erase(std::remove_if(m_candidates.begin(), m_candidates.end(), [&point](Entry* entry) {
+            return !entry->bounds.contains(point);
+        }), m_candidates.end());
+        __Sort(m_candidates, result);
+    }
+    
+    /// All items containing the given point, in insertion order.
+    std::vector<T*> QueryPoint(const sf::Vector2f& point) {
+        std::vector<T*> result;
+        QueryPoint(point, result);
+        return result;
+    }
+    
+    /// Last inserted item containing the given point, which is accepted by the predicate. Null if there is none.
+    /// Unlike QueryPoint(), nothing is collected or sorted, so this is suited for hit-testing on every input event.
+    template<typename TPredicate>
+    T* QueryTopmost(const sf::Vector2f& point, TPredicate predicate) const {
+        const Entry* topmost = nullptr;
+        auto visit = [&](const Entry* entry) {
+            if (topmost && entry->order < topmost->order) return;
+            if (entry->bounds.contains(point) && predicate(entry->item)) topmost = entry;
+        };
+        // a single cell holds every entry once, and large entries are never in a cell
+        for (const Entry* entry : m_large) visit(entry);
+        auto it = m_cells.find(__Key(__Cell(point.x), __Cell(point.y)));
+        if (it != m_cells.end()) {
+            for (const Entry* entry : it->second) visit(entry);
+        }
+        return topmost ? topmost->item : nullptr;
+    }
+    
+    SpatialIndex(const SpatialIndex&) = delete;
+    
+    /// @param cellsize Width and height of a grid cell. Should be close to the typical object size.
+    SpatialIndex(float cellsize) {
+        m_cellsize = std::max(cellsize, 1.0f);
+        m_order = 0U;
+        m_stamp = 0U;
+    }
+    
+    SpatialIndex() : SpatialIndex(64.0f) {}
+    
+    virtual ~SpatialIndex() {}
+    
+};
+
+}
\ No newline at end of file
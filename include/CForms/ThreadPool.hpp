@@ -0,0 +1,190 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+namespace cf {
+
+/// Work-stealing pool of worker threads.
+/// Each worker takes tasks from the back of its own queue, and steals from the front of other queues when it runs dry.
+/// Threads waiting for a task group help executing tasks, so tasks may submit and wait for further tasks.
+class ThreadPool {
+
+public:
+    
+    typedef std::function<void()> Task;
+    
+    /// Counter of unfinished tasks, to wait for a batch of tasks.
+    class TaskGroup {
+        
+        friend class ThreadPool;
+    
+    private:
+        
+        std::atomic<size_t> m_pending;
+    
+    public:
+        
+        /// True if all tasks of the group were executed.
+        bool IsDone() const {
+            return m_pending.load() == 0U;
+        }
+        
+        TaskGroup(const TaskGroup&) = delete;
+        
+        TaskGroup() : m_pending(0U) {}
+        
+        ~TaskGroup() {}
+    
+    };
+    
+private:
+    
+    struct Entry {
+        Task task;
+        TaskGroup* group;
+    };
+    
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Entry> entries;
+    };
+    
+    /// Queue 0 is shared by all threads outside of the pool. Queue i + 1 belongs to worker i.
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::mutex m_sleepmutex;
+    std::condition_variable m_wake;
+    std::atomic<size_t> m_queued;
+    std::atomic<bool> m_stop;
+    
+private:
+    
+    struct Current {
+        const ThreadPool* pool;
+        size_t self;
+    };
+    
+    /// Internal call to get the pool and queue index of the calling worker thread.
+    static Current& __Current() {
+        thread_local Current current{nullptr, 0U};
+        return current;
+    }
+    
+    /// Internal call to get the queue index of the calling thread.
+    size_t __Self() const {
+        const Current& current = __Current();
+        return current.pool == this ? current.self : 0U;
+    }
+    
+    /// Internal call to take a task, from the back of the own queue or the front of another queue.
+    bool __Take(size_t self, Entry& entry) {
+        {
+            Queue& own = *m_queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.entries.empty()) {
+                entry = std::move(own.entries.back());
+                own.entries.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < m_queues.size(); ++i) {
+            Queue& other = *m_queues[(self + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.entries.empty()) {
+                entry = std::move(other.entries.front());
+                other.entries.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    /// Internal call to execute a single queued task. Returns false if no task was queued.
+    bool __RunOne(size_t self) {
+        if (m_queued.load() == 0U) return false;
+        Entry entry;
+        if (!__Take(self, entry)) return false;
+        m_queued--;
+        entry.task();
+        entry.group->m_pending--;
+        return true;
+    }
+    
+    /// Internal operating loop of a worker thread.
+    void __Work(size_t self) {
+        __Current() = {this, self};
+        while (!m_stop.load()) {
+            if (__RunOne(self)) continue;
+            std::unique_lock<std::mutex> lock(m_sleepmutex);
+            m_wake.wait(lock, [this]() { return m_stop.load() || m_queued.load() != 0U; });
+        }
+    }
+    
+public:
+    
+    /// Queue a task to the calling thread's queue.
+    /// @param group Group to count the task in, until it was executed.
+    void Submit(TaskGroup& group, Task task) {
+        group.m_pending++;
+        Queue& queue = *m_queues[__Self()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.entries.push_back({std::move(task), &group});
+        }
+        m_queued++;
+        {
+            std::lock_guard<std::mutex> lock(m_sleepmutex);
+        }
+        m_wake.notify_one();
+    }
+    
+    /// Block until all tasks of the group were executed. The calling thread executes queued tasks meanwhile.
+    void Wait(TaskGroup& group) {
+        size_t self = __Self();
+        while (!group.IsDone()) {
+            if (!__RunOne(self)) std::this_thread::yield();
+        }
+    }
+    
+    /// Ammount of worker threads, not counting threads which wait for tasks.
+    size_t ThreadCount() const {
+        return m_threads.size();
+    }
+    
+    ThreadPool(const ThreadPool&) = delete;
+    
+    /// @param threads Ammount of worker threads. If 0, one less than the ammount of hardware threads.
+    ThreadPool(size_t threads) : m_queued(0U), m_stop(false) {
+        if (threads == 0U) threads = std::max(std::thread::hardware_concurrency(), 2U) - 1U;
+        for (size_t i = 0; i <= threads; ++i) {
+            m_queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 1; i <= threads; ++i) {
+            m_threads.emplace_back(&ThreadPool::__Work, this, i);
+        }
+    }
+    
+    ThreadPool() : ThreadPool(0U) {}
+    
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepmutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+    
+};
+
+}
\ No newline at end of file
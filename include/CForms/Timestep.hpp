@@ -0,0 +1,84 @@
+#pragma once
+
+#include <SFML/System.hpp>
+
+#include <cstdint>
+#include <algorithm>
+
+namespace cf {
+
+/// Fixed timestep state of a cf::Form, shared with its drawable objects for interpolation.
+/// Frame durations are accumulated and consumed in whole steps, so updates do not depend on the frame rate.
+class Timestep {
+
+private:
+    
+    sf::Time m_step;
+    sf::Time m_accumulator;
+    uint32_t m_maxsteps;
+    uint64_t m_steps;
+    float m_alpha;
+    
+public:
+    
+    /// Add the duration of a frame, and get the ammount of update steps to run for it.
+    /// Without a fixed step, every frame runs exactly one update step of the frame's duration.
+    uint32_t Advance(const sf::Time& cycle) {
+        if (m_step <= sf::Time::Zero) {
+            m_alpha = 1.0f;
+            m_steps++;
+            return 1U;
+        }
+        m_accumulator += cycle;
+        int64_t available = m_accumulator.asMicroseconds() / m_step.asMicroseconds();
+        uint32_t steps = uint32_t(std::min<int64_t>(available, m_maxsteps));
+        if (int64_t(steps) < available) {
+            // too far behind to catch up, so the backlog is dropped instead of stalling every following frame
+            m_accumulator = sf::microseconds(m_accumulator.asMicroseconds() % m_step.asMicroseconds());
+        }
+        else {
+            m_accumulator -= m_step * int64_t(steps);
+        }
+        m_alpha = m_accumulator.asSeconds() / m_step.asSeconds();
+        m_steps += steps;
+        return steps;
+    }
+    
+    /// Duration to pass into a single update step of the given frame.
+    sf::Time Delta(const sf::Time& cycle) const {
+        return m_step > sf::Time::Zero ? m_step : cycle;
+    }
+    
+    /// Change the fixed step duration and the maximum ammount of steps per frame. A zero step disables the fixed timestep.
+    void SetStep(const sf::Time& step, uint32_t maxsteps) {
+        if (step != m_step) m_accumulator = sf::Time::Zero;
+        m_step = step;
+        m_maxsteps = std::max<uint32_t>(maxsteps, 1U);
+    }
+    
+    /// Fixed step duration. Zero if the fixed timestep is disabled.
+    const sf::Time& Step() const {
+        return m_step;
+    }
+    
+    /// Progress from the previous towards the next update step, between 0 and 1. Always 1 without a fixed step.
+    float Alpha() const {
+        return m_alpha;
+    }
+    
+    /// Ammount of update steps run so far.
+    uint64_t StepCount() const {
+        return m_steps;
+    }
+    
+    Timestep() {
+        m_maxsteps = 5U;
+        m_steps = 0U;
+        m_alpha = 1.0f;
+    }
+    
+    ~Timestep() {}
+    
+};
+
+}
\ No newline at end of file
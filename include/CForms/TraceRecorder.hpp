@@ -0,0 +1,270 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+namespace cf {
+
+/// Recorder for timelines of a cf::Form, in the Chrome Trace Event JSON format.
+/// Events are collected in a fixed size buffer and streamed to the file by a writer thread, so memory stays bounded.
+/// If the writer falls behind, further events are dropped and counted, instead of stalling the form.
+class TraceRecorder {
+
+public:
+    
+    /// Maximum length of event names, including the terminator. Longer names are cut off.
+    static constexpr size_t NameLength = 48U;
+    
+    /// Measures the time from its construction to its destruction as a single trace event.
+    class Scope {
+    
+    private:
+        
+        TraceRecorder* m_trace;
+        const char* m_category;
+        const char* m_name;
+        const std::string* m_dynamicname;
+        std::chrono::steady_clock::time_point m_start;
+    
+    public:
+        
+        /// @param trace Recorder to write into. Nothing is recorded if null or not recording.
+        /// @param name Event name. Must outlive the scope.
+        Scope(TraceRecorder* trace, const char* category, const char* name) {
+            m_trace = trace && trace->IsRecording() ? trace : nullptr;
+            m_category = category;
+            m_name = name;
+            m_dynamicname = nullptr;
+            if (m_trace) m_start = std::chrono::steady_clock::now();
+        }
+        
+        /// @param name Event name, e.g. of an object. Must outlive the scope.
+        Scope(TraceRecorder* trace, const char* category, const std::string& name) : Scope(trace, category, name.c_str()) {
+            m_dynamicname = &name;
+        }
+        
+        Scope(const Scope&) = delete;
+        
+        ~Scope() {
+            if (!m_trace) return;
+            m_trace->Add(m_category, m_dynamicname ? m_dynamicname->c_str() : m_name, m_start, std::chrono::steady_clock::now());
+        }
+    
+    };
+    
+private:
+    
+    struct TraceEvent {
+        char name[NameLength];
+        const char* category;
+        uint32_t thread;
+        int64_t start;
+        int64_t duration;
+    };
+    
+    std::FILE* m_file;
+    std::vector<TraceEvent> m_active;
+    std::vector<TraceEvent> m_writing;
+    size_t m_capacity;
+    bool m_first;
+    bool m_objects;
+    std::atomic<bool> m_recording;
+    std::atomic<uint64_t> m_dropped;
+    std::chrono::steady_clock::time_point m_start;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_writer;
+    bool m_stop;
+    
+private:
+    
+    /// Internal call to get a small, stable ID of the calling thread.
+    static uint32_t __ThreadID() {
+        static std::atomic<uint32_t> next(1U);
+        thread_local uint32_t id = next++;
+        return id;
+    }
+    
+    /// Internal call to write a JSON string, with quotes and control characters escaped.
+    void __WriteString(const char* text) {
+        std::fputc('"', m_file);
+        for (const char* c = text; *c != '\0'; ++c) {
+            if (*c == '"' || *c == '\\') {
+                std::fputc('\\', m_file);
+                std::fputc(*c, m_file);
+            }
+            else if (uint8_t(*c) < 0x20U) {
+                std::fprintf(m_file, "\\u%04x", unsigned(uint8_t(*c)));
+            }
+            else {
+                std::fputc(*c, m_file);
+            }
+        }
+        std::fputc('"', m_file);
+    }
+    
+    /// Internal call to write a batch of events to the file.
+    void __Write(const std::vector<TraceEvent>& events) {
+        for (const auto& event : events) {
+            std::fputs(m_first ? "\n" : ",\n", m_file);
+            m_first = false;
+            std::fputs("{\"ph\":\"X\",\"pid\":1,\"tid\":", m_file);
+            std::fprintf(m_file, "%u,\"ts\":%.3f,\"dur\":%.3f,\"cat\":", event.thread, double(event.start) / 1000.0, double(event.duration) / 1000.0);
+            __WriteString(event.category);
+            std::fputs(",\"name\":", m_file);
+            __WriteString(event.name);
+            std::fputc('}', m_file);
+        }
+    }
+    
+    /// Internal operating loop of the writer thread.
+    void __Work() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_wake.wait(lock, [this]() { return m_stop || !m_writing.empty(); });
+            if (!m_writing.empty()) {
+                std::vector<TraceEvent> events;
+                events.swap(m_writing);
+                lock.unlock();
+                __Write(events);
+                events.clear();
+                lock.lock();
+                // keep the allocation for the next batch
+                if (m_writing.empty()) m_writing.swap(events);
+                continue;
+            }
+            if (m_stop) break;
+        }
+    }
+    
+    /// Internal call to hand the collected events over to the writer thread. Returns false if it is still busy.
+    /// The mutex has to be held.
+    bool __Submit() {
+        if (m_active.empty()) return true;
+        if (!m_writing.empty()) return false;
+        m_writing.swap(m_active);
+        m_wake.notify_one();
+        return true;
+    }
+    
+public:
+    
+    /// Start recording into a new file. A previous recording is finished first.
+    /// @param objects If true, update and draw scopes of single objects are recorded too.
+    bool Open(const std::string& path, bool objects = false) {
+        Close();
+        m_file = std::fopen(path.c_str(), "w");
+        if (!m_file) {
+            std::cerr << "[X] TraceRecorder: Failed to open '" + path + "'.\n";
+            return false;
+        }
+        std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", m_file);
+        m_first = true;
+        m_objects = objects;
+        m_dropped = 0U;
+        m_stop = false;
+        m_active.reserve(m_capacity);
+        m_writing.reserve(m_capacity);
+        m_start = std::chrono::steady_clock::now();
+        m_writer = std::thread(&TraceRecorder::__Work, this);
+        m_recording = true;
+        return true;
+    }
+    
+    /// Finish the recording, and write all remaining events.
+    void Close() {
+        if (!m_file) return;
+        {
+            // under the lock, so no Add() can append after the last batch was taken
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_recording = false;
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        m_writer.join();
+        std::vector<TraceEvent> events;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            events.swap(m_active);
+        }
+        __Write(events);
+        std::fputs("\n]}\n", m_file);
+        std::fclose(m_file);
+        m_file = nullptr;
+        if (m_dropped != 0U) std::cerr << "[!] TraceRecorder: Dropped " + std::to_string(m_dropped) + " events.\n";
+    }
+    
+    /// Record a single event.
+    /// @param start Start of the event.
+    /// @param end End of the event.
+    void Add(const char* category, const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+        if (!m_recording) return;
+        TraceEvent event;
+        std::strncpy(event.name, name, NameLength - 1U);
+        event.name[NameLength - 1U] = '\0';
+        event.category = category;
+        event.thread = __ThreadID();
+        event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_start).count();
+        event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Close() may have taken the last batch since the check above
+        if (!m_recording) return;
+        if (m_active.size() >= m_capacity && !__Submit()) {
+            m_dropped++;
+            return;
+        }
+        m_active.push_back(event);
+    }
+    
+    /// Hand the events of the finished frame over to the writer thread.
+    void EndFrame() {
+        if (!m_recording) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_recording) __Submit();
+    }
+    
+    /// True while events are recorded.
+    bool IsRecording() const {
+        return m_recording;
+    }
+    
+    /// True if update and draw scopes of single objects are recorded.
+    bool RecordsObjects() const {
+        return m_recording && m_objects;
+    }
+    
+    /// Ammount of events dropped in the current recording, because the writer thread fell behind.
+    uint64_t DroppedCount() const {
+        return m_dropped;
+    }
+    
+    TraceRecorder(const TraceRecorder&) = delete;
+    
+    /// @param capacity Maximum ammount of buffered events. Memory use is bounded by twice this ammount.
+    TraceRecorder(size_t capacity) : m_recording(false), m_dropped(0U) {
+        m_file = nullptr;
+        m_capacity = std::max<size_t>(capacity, 1U);
+        m_first = true;
+        m_objects = false;
+        m_stop = false;
+    }
+    
+    TraceRecorder() : TraceRecorder(16384U) {}
+    
+    ~TraceRecorder() {
+        Close();
+    }
+    
+};
+
+}
\ No newline at end of file
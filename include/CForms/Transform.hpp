@@ -1,20 +1,27 @@
 #pragma once
 
 #include "Event.hpp"
+#include "TransformStore.hpp"
 
 #include <SFML/System.hpp>
 
 namespace cf {
 
 /// Type for position and size of a drawable object.
+/// While attached to a cf::TransformStore, position and size are kept in the store's arrays instead.
 class Transform {
 
+private:
+    
+    TransformStore* m_store;
+    uint32_t m_slot;
+    
 protected:
     
-    /// Position of the transform.
+    /// Position of the transform. Unused while attached to a store.
     sf::Vector2f m_position;
     
-    /// Size of the transform.
+    /// Size of the transform. Unused while attached to a store.
     sf::Vector2u m_size;
     
 public:
@@ -27,89 +34,162 @@ public:
     /// You should subscribe to SizeChanged of a drawable object instead.
     Event<const sf::Vector2u&> __SizeChanged;
     
+    /// Internal event, fired when the transform is destroyed, e.g. so animations drop it.
+    Event<Transform*> __Destroyed;
+    
+private:
+    
+    /// Internal call to write a changed position, and report it.
+    void __WritePosition(const sf::Vector2f& position) {
+        if (m_store) {
+            m_store->m_x[m_slot] = position.x;
+            m_store->m_y[m_slot] = position.y;
+        }
+        else {
+            m_position = position;
+        }
+        __PositionChanged(position);
+    }
+    
+    /// Internal call to write a changed size, and report it.
+    void __WriteSize(const sf::Vector2u& size) {
+        if (m_store) {
+            m_store->m_width[m_slot] = float(size.x);
+            m_store->m_height[m_slot] = float(size.y);
+        }
+        else {
+            m_size = size;
+        }
+        __SizeChanged(size);
+    }
+    
+public:
+    
     /// Get the current position of the object's transform.
-    const sf::Vector2f& Position() const {
+    sf::Vector2f Position() const {
+        if (m_store) return sf::Vector2f(m_store->m_x[m_slot], m_store->m_y[m_slot]);
         return m_position;
     }
     
     /// Get the current x-axis position of the object's transform.
     float X() const {
-        return m_position.x;
+        return m_store ? m_store->m_x[m_slot] : m_position.x;
     }
     
     /// Get the current y-axis position of the object's transform.
     float Y() const {
-        return m_position.y;
+        return m_store ? m_store->m_y[m_slot] : m_position.y;
     }
     
     /// Get the current size of the object's transform.
-    const sf::Vector2u& Size() const {
+    sf::Vector2u Size() const {
+        if (m_store) return sf::Vector2u(uint(m_store->m_width[m_slot]), uint(m_store->m_height[m_slot]));
         return m_size;
     }
     
     /// Get the current width of the object's transform.
     uint Width() const {
-        return m_size.x;
+        return m_store ? uint(m_store->m_width[m_slot]) : m_size.x;
     }
     
     /// Get the current height of the object's transform.
     uint Height() const {
-        return m_size.y;
+        return m_store ? uint(m_store->m_height[m_slot]) : m_size.y;
     }
     
     /// Change the position of the object's transform.
     void SetPosition(const sf::Vector2f& position) {
-        if (m_position == position) return;
-        m_position = position;
-        __PositionChanged(m_position);
+        if (Position() == position) return;
+        __WritePosition(position);
     }
     
     /// Change the x-axis position of the object's transform.
     void SetX(float x) {
-        if (m_position.x == x) return;
-        m_position.x = x;
-        __PositionChanged(m_position);
+        if (X() == x) return;
+        __WritePosition(sf::Vector2f(x, Y()));
     }
     
     /// Change the y-axis position of the object's transform.
     void SetY(float y) {
-        if (m_position.y == y) return;
-        m_position.y = y;
-        __PositionChanged(m_position);
+        if (Y() == y) return;
+        __WritePosition(sf::Vector2f(X(), y));
     }
     
     /// Change the size of the object's transform.
     void SetSize(const sf::Vector2u& size) {
-        if (m_size == size) return;
-        m_size = size;
-        __SizeChanged(m_size);
+        if (Size() == size) return;
+        __WriteSize(size);
     }
     
     /// Change the width of the object's transform.
     void SetWidth(uint width) {
-        if (m_size.x == width) return;
-        m_size.x = width;
-        __SizeChanged(m_size);
+        if (Width() == width) return;
+        __WriteSize(sf::Vector2u(width, Height()));
     }
     
     /// Change the height of the object's transform.
     void SetHeight(uint height) {
-        if (m_size.y == height) return;
-        m_size.y = height;
-        __SizeChanged(m_size);
+        if (Height() == height) return;
+        __WriteSize(sf::Vector2u(Width(), height));
     }
     
-    Transform(const sf::Vector2f& position, const sf::Vector2u& size) {
+    /// Store the transform is attached to. Null if it keeps its own position and size.
+    TransformStore* Store() const {
+        return m_store;
+    }
+    
+    /// Slot of the transform inside its store.
+    uint32_t Slot() const {
+        return m_slot;
+    }
+    
+    /// Internal call to move position and size into a slot of the store. Fires no events.
+    void __Attach(TransformStore* store) {
+        if (m_store) return;
+        m_slot = store->__Attach(m_position, m_size);
+        m_store = store;
+    }
+    
+    /// Internal call to take position and size back from the store, and free the slot. Fires no events.
+    void __Detach() {
+        if (!m_store) return;
+        m_position = Position();
+        m_size = Size();
+        m_store->__Detach(m_slot);
+        m_store = nullptr;
+    }
+    
+    /// Copies position and size only, without subscribers or store.
+    Transform(const Transform& transform) : Transform(transform.Position(), transform.Size()) {}
+    
+    /// Copies position and size only. The transform keeps its own subscribers and store.
+    Transform& operator=(const Transform& transform) {
+        sf::Vector2f position = transform.Position();
+        sf::Vector2u size = transform.Size();
+        if (m_store) {
+            m_store->m_x[m_slot] = position.x;
+            m_store->m_y[m_slot] = position.y;
+            m_store->m_width[m_slot] = float(size.x);
+            m_store->m_height[m_slot] = float(size.y);
+        }
         m_position = position;
         m_size = size;
+        return *this;
     }
     
-    Transform() {
-        m_position = sf::Vector2f(0.0f, 0.0f);
-        m_size = sf::Vector2u(20, 20);
+    Transform(const sf::Vector2f& position, const sf::Vector2u& size) {
+        m_store = nullptr;
+        m_slot = 0U;
+        m_position = position;
+        m_size = size;
     }
     
-    virtual ~Transform() {}
+    Transform() : Transform(sf::Vector2f(0.0f, 0.0f), sf::Vector2u(20, 20)) {}
+    
+    virtual ~Transform() {
+        __Destroyed(this);
+        __Detach();
+    }
     
 };
 
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "Event.hpp"
+#include "Utility.hpp"
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+namespace cf {
+
+class Transform;
+
+/// Structure of arrays with the positions and sizes of many transforms, e.g. all drawable objects of a cf::Form.
+/// Bulk moves run as plain loops over contiguous arrays, which compilers vectorize, and fire no events per object.
+/// Instead, changed slots are collected and reported once through Changed, when the owner flushes the store.
+/// Slots of detached transforms are reused, and hold NaN meanwhile. Not safe for parallel updates.
+class TransformStore {
+
+private:
+    
+    friend class Transform;
+    
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_width;
+    std::vector<float> m_height;
+    std::vector<uint32_t> m_group;
+    std::vector<uint8_t> m_changed;
+    std::vector<uint32_t> m_free;
+    size_t m_count;
+    bool m_pending;
+    
+public:
+    
+    /// Fired by Flush() if slots were changed by bulk operations since the previous flush. IsChanged() tells which.
+    /// @param sender Store which fired the event.
+    Event<TransformStore*> Changed;
+    
+private:
+    
+    /// Internal call to get bounds over a range of slots. Slots are only included where the mask holds.
+    template<typename TMask>
+    sf::FloatRect __Bounds(TMask mask) const {
+        float left = std::numeric_limits<float>::infinity();
+        float top = left;
+        float right = -left;
+        float bottom = -left;
+        const float* x = m_x.data();
+        const float* y = m_y.data();
+        const float* w = m_width.data();
+        const float* h = m_height.data();
+        // free slots are NaN, which never passes the comparisons
+        for (size_t i = 0; i < m_x.size(); ++i) {
+            bool in = mask(i);
+            left = in && x[i] < left ? x[i] : left;
+            top = in && y[i] < top ? y[i] : top;
+            right = in && x[i] + w[i] > right ? x[i] + w[i] : right;
+            bottom = in && y[i] + h[i] > bottom ? y[i] + h[i] : bottom;
+        }
+        if (left > right || top > bottom) return sf::FloatRect();
+        return sf::FloatRect(left, top, right - left, bottom - top);
+    }
+    
+    /// Internal call to add a value to an array.
+    /// One array per loop, so the compiler does not have to check whether arrays overlap before vectorizing.
+    static void __Add(float* values, float value, size_t count) {
+        CF_SIMD
+        for (size_t i = 0; i < count; ++i) values[i] += value;
+    }
+    
+    /// Internal call to add a value to the elements of an array which are in a group.
+    static void __Add(float* values, float value, const uint32_t* groups, uint32_t group, size_t count) {
+        // masks instead of branches, so the loop stays vectorizable
+        CF_SIMD
+        for (size_t i = 0; i < count; ++i) values[i] += groups[i] == group ? value : 0.0f;
+    }
+    
+public:
+    
+    /// Internal call to give a transform a slot, with its current position and size.
+    uint32_t __Attach(const sf::Vector2f& position, const sf::Vector2u& size) {
+        uint32_t slot;
+        if (!m_free.empty()) {
+            slot = m_free.back();
+            m_free.pop_back();
+        }
+        else {
+            slot = uint32_t(m_x.size());
+            m_x.push_back(0.0f);
+            m_y.push_back(0.0f);
+            m_width.push_back(0.0f);
+            m_height.push_back(0.0f);
+            m_group.push_back(0U);
+            m_changed.push_back(0U);
+        }
+        m_x[slot] = position.x;
+        m_y[slot] = position.y;
+        m_width[slot] = float(size.x);
+        m_height[slot] = float(size.y);
+        m_group[slot] = 0U;
+        m_changed[slot] = 0U;
+        m_count++;
+        return slot;
+    }
+    
+    /// Internal call to free the slot of a detached transform.
+    void __Detach(uint32_t slot) {
+        m_x[slot] = std::numeric_limits<float>::quiet_NaN();
+        m_y[slot] = std::numeric_limits<float>::quiet_NaN();
+        m_width[slot] = 0.0f;
+        m_height[slot] = 0.0f;
+        m_group[slot] = 0U;
+        m_changed[slot] = 0U;
+        m_free.push_back(slot);
+        m_count--;
+    }
+    
+    /// Ammount of attached transforms.
+    size_t Count() const {
+        return m_count;
+    }
+    
+    /// Ammount of slots, including free ones. All arrays have this length.
+    size_t SlotCount() const {
+        return m_x.size();
+    }
+    
+    /// X-axis positions of all slots, to change them in custom loops. Call MarkChanged() afterwards.
+    float* X() {
+        return m_x.data();
+    }
+    
+    /// Y-axis positions of all slots, to change them in custom loops. Call MarkChanged() afterwards.
+    float* Y() {
+        return m_y.data();
+    }
+    
+    /// Widths of all slots. Sizes can only be changed through each transform, as drawables recreate their canvas.
+    const float* Width() const {
+        return m_width.data();
+    }
+    
+    /// Heights of all slots. Sizes can only be changed through each transform, as drawables recreate their canvas.
+    const float* Height() const {
+        return m_height.data();
+    }
+    
+    /// Group of a slot. All transforms start in group 0.
+    uint32_t Group(uint32_t slot) const {
+        return m_group[slot];
+    }
+    
+    /// Put a slot into a group, e.g. a map layer, to move it together with the other slots of the group.
+    void SetGroup(uint32_t slot, uint32_t group) {
+        m_group[slot] = group;
+    }
+    
+    /// True if the slot was changed by bulk operations since the previous flush.
+    bool IsChanged(uint32_t slot) const {
+        return m_changed[slot] != 0U;
+    }
+    
+    /// Report a slot changed through X() or Y() at the next flush.
+    void MarkChanged(uint32_t slot) {
+        m_changed[slot] = 1U;
+        m_pending = true;
+    }
+    
+    /// Report all slots at the next flush.
+    void MarkAllChanged() {
+        std::fill(m_changed.begin(), m_changed.end(), uint8_t(1U));
+        m_pending = !m_changed.empty();
+    }
+    
+    /// Move all transforms by an offset.
+    void Move(const sf::Vector2f& offset) {
+        __Add(m_x.data(), offset.x, m_x.size());
+        __Add(m_y.data(), offset.y, m_y.size());
+        MarkAllChanged();
+    }
+    
+    /// Move all transforms of a group by an offset.
+    void Move(uint32_t group, const sf::Vector2f& offset) {
+        __Add(m_x.data(), offset.x, m_group.data(), group, m_x.size());
+        __Add(m_y.data(), offset.y, m_group.data(), group, m_y.size());
+        const uint32_t* g = m_group.data();
+        uint8_t* changed = m_changed.data();
+        uint8_t any = 0U;
+        for (size_t i = 0; i < m_changed.size(); ++i) {
+            uint8_t in = g[i] == group;
+            changed[i] |= in;
+            any |= in;
+        }
+        if (any) m_pending = true;
+    }
+    
+    /// Bounds around all transforms. Empty if there are none.
+    sf::FloatRect Bounds() const {
+        return __Bounds([](size_t) { return true; });
+    }
+    
+    /// Bounds around all transforms of a group. Empty if there are none.
+    sf::FloatRect Bounds(uint32_t group) const {
+        const uint32_t* g = m_group.data();
+        return __Bounds([g, group](size_t i) { return g[i] == group; });
+    }
+    
+    /// Report all slots changed by bulk operations through Changed, and reset them. Called once per frame by the owning form.
+    void Flush() {
+        if (!m_pending) return;
+        m_pending = false;
+        Changed(this);
+        std::fill(m_changed.begin(), m_changed.end(), uint8_t(0U));
+    }
+    
+    TransformStore(const TransformStore&) = delete;
+    
+    TransformStore() {
+        m_count = 0U;
+        m_pending = false;
+    }
+    
+    ~TransformStore() {}
+    
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace cf {
+
+/// Lock-free handoff of values from one producer thread to one consumer thread.
+/// The producer fills Back() and publishes it, the consumer acquires the latest published value as Front().
+/// Neither side ever waits for the other, and values which were not acquired in time are overwritten.
+template<typename T>
+class TripleBuffer {
+
+private:
+    
+    /// Set in the shared index, if the slot was published and not acquired yet.
+    static constexpr uint8_t Fresh = 0x4U;
+    
+    T m_slots[3];
+    std::atomic<uint8_t> m_shared;
+    uint8_t m_back;
+    uint8_t m_front;
+    
+public:
+    
+    /// Slot of the producer. Only the producer thread may access it.
+    T& Back() {
+        return m_slots[m_back];
+    }
+    
+    /// Latest acquired slot of the consumer. Only the consumer thread may access it.
+    T& Front() {
+        return m_slots[m_front];
+    }
+    
+    /// All three slots, e.g. to resize them. Neither thread may access slots meanwhile.
+    T& Slot(uint8_t index) {
+        return m_slots[index % 3U];
+    }
+    
+    /// Hand the producer's slot over to the consumer, and continue with another slot. Called by the producer.
+    void Publish() {
+        m_back = m_shared.exchange(m_back | Fresh) & ~Fresh;
+    }
+    
+    /// Take over the latest published slot. Returns false if nothing was published since the previous call. Called by the consumer.
+    bool Acquire() {
+        if (!(m_shared.load() & Fresh)) return false;
+        m_front = m_shared.exchange(m_front) & ~Fresh;
+        return true;
+    }
+    
+    /// True if a slot was published and not acquired yet.
+    bool HasFresh() const {
+        return (m_shared.load() & Fresh) != 0U;
+    }
+    
+    TripleBuffer(const TripleBuffer&) = delete;
+    
+    TripleBuffer() : m_shared(1U), m_back(0U), m_front(2U) {}
+    
+    ~TripleBuffer() {}
+    
+};
+
+}
\ No newline at end of file
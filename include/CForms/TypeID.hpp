@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace cf {
+
+/// Process-wide integer IDs of types, assigned on first use without RTTI.
+/// IDs are dense, starting at 0, so they can index arrays.
+class TypeID {
+
+private:
+    
+    /// Internal call to hand out the next free type ID.
+    static size_t __Next() {
+        static std::atomic<size_t> next(0U);
+        return next++;
+    }
+    
+public:
+    
+    /// Integer ID of the type <T>.
+    template<typename T>
+    static size_t Of() {
+        static const size_t id = __Next();
+        return id;
+    }
+    
+};
+
+}
\ No newline at end of file
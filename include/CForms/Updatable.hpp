@@ -1,20 +1,95 @@
 #pragma once
 
 #include "Object.hpp"
+#include "Scheduler.hpp"
 
 #include <SFML/System.hpp>
+#include <memory>
+#include <atomic>
 
 namespace cf {
 
+class Animator;
+
 /// Base type for updatable objects.
+/// Objects can fall asleep through Sleep(), so their owner skips them until Wake(), or update in an interval instead of every frame.
 class Updatable : public virtual Object {
 
+private:
+    
+    friend class UpdateBatch;
+    
+    std::atomic<bool> m_awake;
+    bool m_listed;
+    uint64_t m_sequence;
+    bool m_slept;
+    sf::Time m_sleptat;
+    uint64_t m_intervaltimer;
+    
+protected:
+    
+    /// Thread-safe update. If true, the object may be updated in parallel to any other object, when its form updates in parallel.
+    /// Update() must then only change the object itself, and its children. Objects may only be created or deleted through CreateLater() and DeleteLater().
+    bool m_threadsafe;
+    
+    /// Dependency group of the update. Objects of the same group are updated in order, while groups are updated in parallel to each other, when their form updates in parallel.
+    /// Update() must then only change objects of the same group. If 0, m_threadsafe decides.
+    uint32_t m_updategroup;
+    
+    /// Update interval. If zero, the object is updated every frame. Otherwise, it sleeps between updates and is woken once per interval.
+    /// Change it through SetUpdateInterval() after creation.
+    sf::Time m_updateinterval;
+    
+    /// Wake-only updates. If true, the object falls asleep after every update, and is only updated again after Wake().
+    bool m_wakeonly;
+    
+    /// Timers and frame requests of the object's form. Null until the object was created by a form or control.
+    std::shared_ptr<cf::Scheduler> m_scheduler;
+    
+    /// Tweens of the object's form, e.g. to move or recolor child objects. Include "CForms/Animator.hpp" to use it.
+    /// Null until the object was created by a form or control.
+    std::shared_ptr<cf::Animator> m_animator;
+    
+public:
+    
+    /// Internal event, fired when the object was woken through Wake(). Its owner then updates it again.
+    Event<Updatable*> __Woken;
+    
+private:
+    
+    /// Internal call to restart the timer which wakes the object once per update interval.
+    void __StartIntervalTimer() {
+        if (!m_scheduler) return;
+        if (m_intervaltimer != 0U) m_scheduler->CancelTimer(m_intervaltimer);
+        m_intervaltimer = 0U;
+        if (m_updateinterval > sf::Time::Zero) m_intervaltimer = m_scheduler->SetTimer(m_updateinterval, [this]() { Wake(); }, true);
+    }
+    
 protected:
     
     /// Override this to update your object.
     /// @param delta Execution time of the previous cycle.
     virtual void Update(const sf::Time& delta) {}
     
+    /// Request one more frame of the form. Call this every update while animating, so a form in idle mode keeps running.
+    void RequestFrame() {
+        if (m_scheduler) m_scheduler->RequestFrame();
+    }
+    
+    /// Call a function once after a delay, or repeatedly in an interval, on the form's thread before its update.
+    /// Cancel the timer through CancelTimer() before the object is destroyed.
+    /// @return ID of the timer. 0 if the object has no form.
+    uint64_t SetTimer(const sf::Time& delay, Scheduler::Callback callback, bool repeat = false) {
+        if (!m_scheduler) return 0U;
+        return m_scheduler->SetTimer(delay, std::move(callback), repeat);
+    }
+    
+    /// Cancel a timer started through SetTimer().
+    bool CancelTimer(uint64_t id) {
+        if (!m_scheduler) return false;
+        return m_scheduler->CancelTimer(id);
+    }
+    
 public:
     
     /// Internal Update() call of the object.
@@ -22,11 +97,86 @@ public:
         Update(delta);
     }
     
+    /// Internal call to get the delta of the object's next update. Objects which were asleep get the deltas of all steps since they fell asleep instead.
+    sf::Time __Elapsed(const sf::Time& delta) {
+        if (!m_slept) return delta;
+        m_slept = false;
+        return m_scheduler ? m_scheduler->UpdateTime() - m_sleptat : delta;
+    }
+    
+    /// Internal call after the object was updated. Puts interval and wake-only objects to sleep.
+    void __Updated() {
+        if (m_wakeonly || m_updateinterval > sf::Time::Zero) Sleep();
+    }
+    
+    /// Stop updating the object until Wake() is called. Child objects of a sleeping control are not updated either.
+    void Sleep() {
+        if (!m_awake.exchange(false)) return;
+        m_slept = true;
+        if (m_scheduler) m_sleptat = m_scheduler->UpdateTime();
+    }
+    
+    /// Update the object again, starting with the next update of its owner.
+    /// Safe to call from parallel updates, timers and event handlers of the form's thread.
+    void Wake() {
+        if (m_awake.exchange(true)) return;
+        __Woken(this);
+    }
+    
+    /// True if the object is updated by its owner.
+    bool IsAwake() const {
+        return m_awake.load(std::memory_order_relaxed);
+    }
+    
+    /// Current update interval of the object. Zero if it is updated every frame.
+    const sf::Time& UpdateInterval() const {
+        return m_updateinterval;
+    }
+    
+    /// Change the update interval of the object. Zero updates the object every frame again.
+    void SetUpdateInterval(const sf::Time& interval) {
+        if (interval == m_updateinterval) return;
+        m_updateinterval = interval;
+        __StartIntervalTimer();
+        if (m_updateinterval == sf::Time::Zero && !m_wakeonly) Wake();
+    }
+    
+    /// Internal call to share the scheduler of the form with the object.
+    void __SetScheduler(const std::shared_ptr<cf::Scheduler>& scheduler) {
+        m_scheduler = scheduler;
+        __StartIntervalTimer();
+    }
+    
+    /// Internal call to share the animator of the form with the object.
+    void __SetAnimator(const std::shared_ptr<cf::Animator>& animator) {
+        m_animator = animator;
+    }
+    
+    /// True if the object may be updated in parallel to any other object.
+    bool IsThreadSafe() const {
+        return m_threadsafe;
+    }
+    
+    /// Dependency group of the object's update. 0 if the object is in no group.
+    uint32_t UpdateGroup() const {
+        return m_updategroup;
+    }
+    
     /// Do not use this constructor!
     /// Types derived from cf::Updatable should call cf::Object(owner, name) or cf::Object(name) on their constructor!
-    Updatable() {}
+    Updatable() : m_awake(true) {
+        m_listed = false;
+        m_sequence = 0U;
+        m_slept = false;
+        m_intervaltimer = 0U;
+        m_threadsafe = false;
+        m_updategroup = 0U;
+        m_wakeonly = false;
+    }
     
-    virtual ~Updatable() {}
+    virtual ~Updatable() {
+        if (m_scheduler && m_intervaltimer != 0U) m_scheduler->CancelTimer(m_intervaltimer);
+    }
     
 };
 
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "Updatable.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+#include <SFML/System.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+
+namespace cf {
+
+/// Update pass over the awake updatable objects of a cf::Form or cf::Control.
+/// Sleeping objects are kept out of the pass, so they cost nothing per frame. Awake objects are updated in creation order.
+/// With a thread pool, thread-safe objects and dependency groups are updated in parallel, followed by all other objects in order.
+class UpdateBatch {
+
+private:
+    
+    struct Entry {
+        uint64_t sequence;
+        Updatable* updatable;
+    };
+    
+    std::vector<Entry> m_active;
+    std::vector<Updatable*> m_woken;
+    std::vector<Updatable*> m_merging;
+    std::mutex m_wokenmutex;
+    uint64_t m_sequence;
+    std::vector<Updatable*> m_serial;
+    std::vector<Updatable*> m_threadsafe;
+    std::vector<std::vector<Updatable*>> m_groups;
+    std::unordered_map<uint32_t, size_t> m_groupindex;
+    
+private:
+    
+    /// Orders entries by creation.
+    static bool __Before(const Entry& a, const Entry& b) {
+        return a.sequence < b.sequence;
+    }
+    
+    /// Internal call to update a single object.
+    static void __Update(Updatable* updatable, const sf::Time& delta, Profiler* profiler) {
+        Profiler::Scope scope(profiler, updatable, Profiler::UpdateTotal);
+        updatable->__UpdateCall(updatable->__Elapsed(delta));
+        updatable->__Updated();
+    }
+    
+    /// Internal call to update a range of objects in order.
+    static void __Update(Updatable* const* begin, Updatable* const* end, const sf::Time& delta, Profiler* profiler) {
+        for (auto it = begin; it != end; ++it) {
+            if ((*it)->Error() != 0U) continue;
+            __Update(*it, delta, profiler);
+        }
+    }
+    
+    /// Internal handler call to add woken objects back into the pass.
+    void __OnWoken(Updatable* updatable) {
+        std::lock_guard<std::mutex> lock(m_wokenmutex);
+        m_woken.push_back(updatable);
+    }
+    
+    /// Internal call to drop removed and sleeping objects from the pass, and to merge woken objects back in.
+    void __Refresh() {
+        size_t kept = 0U;
+        for (const Entry& entry : m_active) {
+            if (!entry.updatable) continue;
+            if (!entry.updatable->IsAwake()) {
+                entry.updatable->m_listed = false;
+                continue;
+            }
+            m_active[kept++] = entry;
+        }
+        m_active.resize(kept);
+        {
+            std::lock_guard<std::mutex> lock(m_wokenmutex);
+            m_merging.swap(m_woken);
+        }
+        if (m_merging.empty()) return;
+        for (Updatable* updatable : m_merging) {
+            if (!updatable->IsAwake() || updatable->m_listed) continue;
+            updatable->m_listed = true;
+            m_active.push_back(Entry{updatable->m_sequence, updatable});
+        }
+        m_merging.clear();
+        std::sort(m_active.begin() + kept, m_active.end(), &UpdateBatch::__Before);
+        std::inplace_merge(m_active.begin(), m_active.begin() + kept, m_active.end(), &UpdateBatch::__Before);
+    }
+    
+public:
+    
+    /// Add a new object to the pass.
+    void Add(Updatable* updatable) {
+        updatable->m_sequence = ++m_sequence;
+        updatable->m_listed = false;
+        updatable->__Woken.Bind(&UpdateBatch::__OnWoken, this);
+        if (updatable->IsAwake()) __OnWoken(updatable);
+    }
+    
+    /// Remove an object from the pass, before it is destroyed.
+    void Remove(Updatable* updatable) {
+        updatable->__Woken.Unbind(&UpdateBatch::__OnWoken, this);
+        if (updatable->m_listed) {
+            auto it = std::lower_bound(m_active.begin(), m_active.end(), Entry{updatable->m_sequence, nullptr}, &UpdateBatch::__Before);
+            if (it != m_active.end() && it->updatable == updatable) it->updatable = nullptr;
+            updatable->m_listed = false;
+        }
+        std::lock_guard<std::mutex> lock(m_wokenmutex);
+        m_woken.erase(std::remove(m_woken.begin(), m_woken.end(), updatable), m_woken.end());
+    }
+    
+    /// Ammount of awake objects, as of the latest update pass.
+    size_t AwakeCount() const {
+        return m_active.size();
+    }
+    
+    /// Update all awake objects.
+    /// @param pool Thread pool for thread-safe objects and dependency groups. If null, all objects are updated in order on the calling thread.
+    /// @param profiler Profiler to record the update timings of the objects into. Optional.
+    void Run(const sf::Time& delta, ThreadPool* pool, Profiler* profiler = nullptr) {
+        __Refresh();
+        if (!pool) {
+            for (size_t i = 0; i < m_active.size(); ++i) {
+                Updatable* updatable = m_active[i].updatable;
+                if (!updatable || updatable->Error() != 0U) continue;
+                __Update(updatable, delta, profiler);
+            }
+            return;
+        }
+        
+        m_serial.clear();
+        m_threadsafe.clear();
+        m_groupindex.clear();
+        size_t groups = 0U;
+        for (const Entry& entry : m_active) {
+            Updatable* updatable = entry.updatable;
+            if (!updatable || updatable->Error() != 0U) continue;
+            if (updatable->UpdateGroup() != 0U) {
+                auto it = m_groupindex.emplace(updatable->UpdateGroup(), groups).first;
+                if (it->second == groups) {
+                    if (groups == m_groups.size()) m_groups.emplace_back();
+                    m_groups[groups++].clear();
+                }
+                m_groups[it->second].push_back(updatable);
+            }
+            else if (updatable->IsThreadSafe()) {
+                m_threadsafe.push_back(updatable);
+            }
+            else {
+                m_serial.push_back(updatable);
+            }
+        }
+        
+        ThreadPool::TaskGroup tasks;
+        for (size_t i = 0; i < groups; ++i) {
+            const auto& group = m_groups[i];
+            pool->Submit(tasks, [&group, &delta, profiler]() {
+                __Update(group.data(), group.data() + group.size(), delta, profiler);
+            });
+        }
+        // a few chunks per thread, so stealing can even out uneven update costs
+        size_t chunk = std::max<size_t>(1U, m_threadsafe.size() / ((pool->ThreadCount() + 1U) * 4U));
+        for (size_t i = 0; i < m_threadsafe.size(); i += chunk) {
+            Updatable* const* begin = m_threadsafe.data() + i;
+            Updatable* const* end = m_threadsafe.data() + std::min(i + chunk, m_threadsafe.size());
+            pool->Submit(tasks, [begin, end, &delta, profiler]() {
+                __Update(begin, end, delta, profiler);
+            });
+        }
+        pool->Wait(tasks);
+        
+        __Update(m_serial.data(), m_serial.data() + m_serial.size(), delta, profiler);
+    }
+    
+    UpdateBatch(const UpdateBatch&) = delete;
+    
+    UpdateBatch() {
+        m_sequence = 0U;
+    }
+    
+    ~UpdateBatch() {}
+    
+};
+
+}
\ No newline at end of file
@@ -4,6 +4,14 @@
 #include <string>
 #include <stdexcept>
 
+/// Marks a loop over independent array elements for vectorization, also below -O3.
+/// Takes effect when compiled with -fopenmp-simd and CF_OPENMP_SIMD defined, as the CMake build does, or with -fopenmp. Otherwise the loop is left to the optimizer.
+#if defined(_OPENMP) || defined(CF_OPENMP_SIMD)
+#define CF_SIMD _Pragma("omp simd")
+#else
+#define CF_SIMD
+#endif
+
 namespace cf {
 
 /// Create a formatted string, similar to printf().
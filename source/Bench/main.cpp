@@ -0,0 +1,371 @@
+#include "CForms/Event.hpp"
+#include "CForms/ObjectOwner.hpp"
+#include "CForms/PoolAllocator.hpp"
+#include "CForms/Collection.hpp"
+#include "CForms/Transform.hpp"
+#include "CForms/TransformStore.hpp"
+#include "CForms/Animator.hpp"
+#include "CForms/Drawable.hpp"
+#include "CForms/Updatable.hpp"
+#include "CForms/Form.hpp"
+
+#include <X11/Xlib.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// Subscriber with a side effect, so invocations are not optimized away
+struct Counter {
+    
+    volatile uint64_t value = 0;
+    
+    void Add(const int& amount) {
+        value = value + amount;
+    }
+    
+};
+
+static volatile uint64_t s_free = 0;
+
+// Results of measured calls are stored here, so the calls are not optimized away
+static volatile uint64_t s_sink = 0;
+
+// Plain object without any behavior
+class BenchObject : public cf::Object {
+
+public:
+    
+    BenchObject(cf::ObjectOwner* owner, const std::string& name) : cf::Object(owner, name) {}
+    
+};
+
+// Object owner which exposes creation and deletion to the benchmarks
+class BenchOwner : public cf::ObjectOwner {
+
+public:
+    
+    using cf::ObjectOwner::Create;
+    using cf::ObjectOwner::Delete;
+    
+    BenchOwner() : cf::Object("BenchOwner") {}
+    
+};
+
+// Drawable object outside of a form, to measure transform notifications
+class BenchDrawable : public cf::Drawable {
+
+public:
+    
+    BenchDrawable() : cf::Object("BenchDrawable") {}
+    
+};
+
+// Small object which optionally moves and redraws every frame
+class BenchSprite : public cf::Updatable, public cf::Drawable {
+
+private:
+    
+    bool m_moving;
+    
+protected:
+    
+    virtual bool Init() override {
+        m_transform.SetSize({4, 4});
+        if (!cf::Drawable::Init()) return false;
+        return true;
+    }
+    
+    virtual void Update(const sf::Time& delta) override {
+        if (!m_moving) return;
+        m_transform.SetX(m_transform.X() >= 795.0f ? 0.0f : m_transform.X() + 1.0f);
+        SetDirty();
+    }
+    
+    virtual void Draw() override {
+        Clear(sf::Color(0x00FF00FF));
+    }
+    
+public:
+    
+    void SetMoving(bool moving) {
+        m_moving = moving;
+    }
+    
+    BenchSprite(cf::ObjectOwner* owner, const std::string& name) : cf::Object(owner, name) {
+        m_moving = false;
+    }
+    
+};
+
+// Headless form which creates the given ammount of sprites
+class BenchForm : public cf::Form {
+
+private:
+    
+    size_t m_objects;
+    bool m_moving;
+    uint64_t m_warmup;
+    std::chrono::steady_clock::time_point m_start;
+    
+protected:
+    
+    virtual bool Init() override {
+        for (size_t i = 0; i < m_objects; ++i) {
+            BenchSprite* sprite = Create<BenchSprite>("Sprite" + std::to_string(i));
+            if (!sprite) return false;
+            sprite->SetMoving(m_moving);
+            sprite->Transform()->SetPosition({float((i * 8U) % 796U), float((i / 100U) % 596U)});
+        }
+        return true;
+    }
+    
+    virtual void Update(const sf::Time& delta) override {
+        if (FrameCount() == m_warmup) m_start = std::chrono::steady_clock::now();
+    }
+    
+public:
+    
+    // Runs a few warmup frames and the given ammount of frames, and returns the average duration of a frame in microseconds
+    double RunFrames(uint64_t frames) {
+        Run(m_warmup + frames);
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_start).count() / double(frames);
+    }
+    
+    BenchForm(size_t objects, bool moving) : cf::Object("BenchForm") {
+        m_objects = objects;
+        m_moving = moving;
+        m_warmup = 10U;
+        m_size = {800, 600};
+        m_useatlas = true;
+        m_headless = true;
+    }
+    
+};
+
+static void AddFree(const int& amount) {
+    s_free = s_free + amount;
+}
+
+// Runs the function the given ammount of times and prints the average time per iteration
+template<typename F>
+void Measure(const std::string& name, uint64_t iterations, F&& function) {
+    for (uint64_t i = 0; i < iterations / 10U; ++i) function();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) function();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / double(iterations);
+    std::cout << std::left << std::setw(40) << name << std::right << std::setw(10) << std::fixed << std::setprecision(2) << ns << " ns\n";
+}
+
+static void BenchEvent(uint64_t iterations) {
+    std::cout << "cf::Event\n";
+    
+    cf::Event<const int&> empty;
+    Measure("invoke, 0 subscribers", iterations, [&empty]() { empty(1); });
+    
+    Counter counters[8];
+    cf::Event<const int&> single;
+    single.Bind(&Counter::Add, &counters[0]);
+    Measure("invoke, 1 member subscriber", iterations, [&single]() { single(1); });
+    
+    cf::Event<const int&> free;
+    free.Bind(&AddFree);
+    Measure("invoke, 1 free subscriber", iterations, [&free]() { free(1); });
+    
+    cf::Event<const int&> lambda;
+    lambda += [&counters](const int& amount) { counters[1].Add(amount); };
+    Measure("invoke, 1 lambda subscriber", iterations, [&lambda]() { lambda(1); });
+    
+    cf::Event<const int&> many;
+    for (auto& counter : counters) many.Bind(&Counter::Add, &counter);
+    Measure("invoke, 8 member subscribers", iterations, [&many]() { many(1); });
+    
+    cf::Event<const int&> bind;
+    Measure("bind + unbind, 1 member subscriber", iterations / 10U, [&bind, &counters]() {
+        bind.Bind(&Counter::Add, &counters[0]);
+        bind.Unbind(&Counter::Add, &counters[0]);
+    });
+    
+    std::cout << "std::function (reference)\n";
+    
+    std::vector<std::function<void(const int&)>> functions;
+    functions.push_back([&counters](const int& amount) { counters[0].Add(amount); });
+    Measure("invoke, 1 subscriber", iterations, [&functions]() {
+        for (auto& function : functions) function(1);
+    });
+    
+    functions.clear();
+    for (auto& counter : counters) functions.push_back([&counter](const int& amount) { counter.Add(amount); });
+    Measure("invoke, 8 subscribers", iterations, [&functions]() {
+        for (auto& function : functions) function(1);
+    });
+}
+
+static void BenchObjectOwner(uint64_t iterations) {
+    std::cout << "cf::ObjectOwner\n";
+    
+    BenchOwner owner;
+    Measure("create + delete", iterations / 10U, [&owner]() {
+        owner.Delete(owner.Create<BenchObject>("Object"));
+    });
+    
+    std::vector<BenchObject*> objects;
+    for (size_t i = 0; i < 10000U; ++i) objects.push_back(owner.Create<BenchObject>("Object" + std::to_string(i)));
+    size_t index = 0;
+    Measure("get by ID, 10k objects", iterations, [&owner, &objects, &index]() {
+        s_sink = uintptr_t(owner.Get(objects[index++ % objects.size()]->ID()));
+    });
+    const std::string name = "Object5000";
+    Measure("get by name, 10k objects", iterations, [&owner, &name]() {
+        s_sink = uintptr_t(owner.Get(std::string_view(name)));
+    });
+    Measure("get all of type, 10k objects", iterations, [&owner]() {
+        s_sink = owner.All<BenchObject>().size();
+    });
+    Measure("iterate all of type, 10k objects", iterations / 1000U, [&owner]() {
+        uint64_t sum = 0U;
+        for (BenchObject* object : owner.All<BenchObject>()) sum += object->ID();
+        s_sink = sum;
+    });
+    Measure("create + delete, 10k objects", iterations / 10U, [&owner]() {
+        owner.Delete(owner.Create<BenchObject>("Object"));
+    });
+    
+    BenchOwner pooled;
+    pooled.SetAllocator(std::make_shared<cf::PoolAllocator>());
+    Measure("create + delete, pool allocator", iterations / 10U, [&pooled]() {
+        pooled.Delete(pooled.Create<BenchObject>("Object"));
+    });
+}
+
+static void BenchCollection(uint64_t iterations) {
+    std::cout << "cf::Collection\n";
+    
+    BenchOwner owner;
+    std::vector<BenchObject*> objects;
+    for (size_t i = 0; i < 1000U; ++i) objects.push_back(owner.Create<BenchObject>("Object" + std::to_string(i)));
+    
+    cf::Collection<BenchObject> collection;
+    Measure("add + remove all, 1k items", iterations / 10000U, [&collection, &objects]() {
+        for (BenchObject* object : objects) collection.Add(object);
+        for (BenchObject* object : objects) collection.Remove(object);
+    });
+    
+    for (BenchObject* object : objects) collection.Add(object);
+    size_t index = 0;
+    Measure("contains, 1k items", iterations / 100U, [&collection, &objects, &index]() {
+        s_sink = collection.Contains(objects[index++ % objects.size()]);
+    });
+    Measure("index of, 1k items", iterations / 100U, [&collection, &objects, &index]() {
+        s_sink = collection.IndexOf(objects[index++ % objects.size()]);
+    });
+    Measure("iterate, 1k items", iterations / 100U, [&collection]() {
+        uint64_t sum = 0U;
+        for (BenchObject* object : collection) sum += object->ID();
+        s_sink = sum;
+    });
+}
+
+static void BenchTransform(uint64_t iterations) {
+    std::cout << "cf::Transform\n";
+    
+    cf::Transform transform;
+    float x = 0.0f;
+    Measure("set x, no subscribers", iterations, [&transform, &x]() {
+        transform.SetX(x += 1.0f);
+    });
+    Measure("set position, no subscribers", iterations, [&transform, &x]() {
+        x += 1.0f;
+        transform.SetPosition({x, x});
+    });
+    
+    BenchDrawable drawable;
+    Measure("set x, drawable", iterations, [&drawable, &x]() {
+        drawable.Transform()->SetX(x += 1.0f);
+    });
+    Measure("set position, drawable", iterations, [&drawable, &x]() {
+        x += 1.0f;
+        drawable.Transform()->SetPosition({x, x});
+    });
+    Measure("set position unchanged, drawable", iterations, [&drawable]() {
+        drawable.Transform()->SetPosition({1.0f, 1.0f});
+    });
+    
+    std::vector<std::unique_ptr<BenchDrawable>> drawables;
+    for (size_t i = 0; i < 50000U; ++i) drawables.push_back(std::make_unique<BenchDrawable>());
+    Measure("move 50k drawables one by one", iterations / 100000U, [&drawables]() {
+        for (auto& drawable : drawables) drawable->Transform()->SetX(drawable->Transform()->X() + 1.0f);
+    });
+    
+    cf::TransformStore store;
+    std::vector<cf::Transform> transforms(50000U);
+    for (auto& transform : transforms) transform.__Attach(&store);
+    Measure("move 50k, transform store", iterations / 100000U, [&store]() {
+        store.Move(sf::Vector2f(1.0f, 0.0f));
+        store.Flush();
+    });
+    for (size_t i = 0; i < transforms.size(); i += 2U) store.SetGroup(transforms[i].Slot(), 1U);
+    Measure("move 25k of 50k, transform store group", iterations / 100000U, [&store]() {
+        store.Move(1U, sf::Vector2f(1.0f, 0.0f));
+        store.Flush();
+    });
+}
+
+static void BenchAnimator(uint64_t iterations) {
+    std::cout << "cf::Animator\n";
+    
+    cf::TransformStore store;
+    std::vector<cf::Transform> transforms(10000U);
+    cf::Animator animator;
+    for (auto& transform : transforms) animator.Move(&transform, sf::Vector2f(100.0f, 100.0f), sf::seconds(1.0f), cf::Animator::Easing::QuadInOut, cf::Animator::Repeat::Loop);
+    Measure("run 10k moves", iterations / 100000U, [&animator]() {
+        animator.__Run(sf::milliseconds(16));
+    });
+    
+    for (auto& transform : transforms) transform.__Attach(&store);
+    Measure("run 10k moves, transform store", iterations / 100000U, [&animator, &store]() {
+        animator.__Run(sf::milliseconds(16));
+        store.Flush();
+    });
+}
+
+static void BenchFrame(uint64_t frames) {
+    std::cout << "cf::Form frame\n";
+    
+    // the OpenGL context of SFML needs a display, run under Xvfb to benchmark without a screen
+    Display* display = XOpenDisplay(nullptr);
+    if (!display) {
+        std::cout << "skipped, no display\n";
+        return;
+    }
+    XCloseDisplay(display);
+    
+    for (size_t objects : {10U, 100U, 1000U, 10000U, 100000U}) {
+        for (bool moving : {false, true}) {
+            BenchForm form(objects, moving);
+            double us = form.RunFrames(frames);
+            std::string name = std::to_string(objects) + (moving ? " moving" : " static") + " objects";
+            std::cout << std::left << std::setw(40) << name << std::right << std::setw(10) << std::fixed << std::setprecision(2) << us << " us\n";
+        }
+    }
+}
+
+// Usage: cforms_bench [iterations] [frames]
+int main(int argc, char** argv) {
+    uint64_t iterations = 10000000U;
+    uint64_t frames = 200U;
+    if (argc > 1) iterations = std::stoull(argv[1]);
+    if (argc > 2) frames = std::stoull(argv[2]);
+    
+    BenchEvent(iterations);
+    BenchObjectOwner(iterations);
+    BenchCollection(iterations);
+    BenchTransform(iterations);
+    BenchAnimator(iterations);
+    BenchFrame(frames);
+    return 0;
+}
\ No newline at end of file